@@ -3,6 +3,9 @@
 #include <iterator>
 #include <algorithm>
 #include <functional>
+#include <filesystem>
+
+#include <sys/resource.h>
 
 #include <misc/constants.hpp>
 #include <misc/util/util.hpp>
@@ -11,55 +14,110 @@
 #include <frontend/lexer/lexer.hpp>
 #include <frontend/parser/ast_nodes.hpp>
 #include <backend/eval/intrinsics.hpp>
+#include <backend/eval/eval.hpp>
 
 
 namespace wpp {
-	std::string evaluate(const wpp::node_t, wpp::Env&, wpp::FnEnv*);
-
 	namespace {
-		std::string eval_intrinsic_run(wpp::node_t, const FnInvoke&, wpp::Env&, wpp::FnEnv*);
-		std::string eval_intrinsic_pipe(wpp::node_t, const FnInvoke&, wpp::Env&, wpp::FnEnv*);
-		std::string eval_intrinsic_log(wpp::node_t, const FnInvoke&, wpp::Env&, wpp::FnEnv*);
-		std::string eval_intrinsic_error(wpp::node_t, const FnInvoke&, wpp::Env&, wpp::FnEnv*);
-		std::string eval_intrinsic_assert(wpp::node_t, const FnInvoke&, wpp::Env&, wpp::FnEnv*);
-		std::string eval_intrinsic_file(wpp::node_t, const FnInvoke&, wpp::Env&, wpp::FnEnv*);
-		std::string eval_intrinsic_use(wpp::node_t, const FnInvoke&, wpp::Env&, wpp::FnEnv*);
-
-		std::string eval_fninvoke(wpp::node_t, const FnInvoke&, wpp::Env&, wpp::FnEnv*);
-		std::string eval_fn(wpp::node_t, const Fn&, wpp::Env&, wpp::FnEnv*);
-		std::string eval_codeify(wpp::node_t, const Codeify&, wpp::Env&, wpp::FnEnv*);
-		std::string eval_varref(wpp::node_t, const VarRef&, wpp::Env&, wpp::FnEnv*);
-		std::string eval_var(wpp::node_t, const Var&, wpp::Env&, wpp::FnEnv*);
-		std::string eval_pop(wpp::node_t, const Pop&, wpp::Env&, wpp::FnEnv*);
-		std::string eval_drop(wpp::node_t, const Drop&, wpp::Env&, wpp::FnEnv*);
-		std::string eval_string(wpp::node_t, const String&, wpp::Env&, wpp::FnEnv*);
-		std::string eval_new(wpp::node_t, const String&, wpp::Env&, wpp::FnEnv*);
-		std::string eval_cat(wpp::node_t, const Concat&, wpp::Env&, wpp::FnEnv*);
-		std::string eval_slice(wpp::node_t, const Concat&, wpp::Env&, wpp::FnEnv*);
-		std::string eval_block(wpp::node_t, const Block&, wpp::Env&, wpp::FnEnv*);
-		std::string eval_match(wpp::node_t, const Match&, wpp::Env&, wpp::FnEnv*);
-		std::string eval_document(wpp::node_t, const Document&, wpp::Env&, wpp::FnEnv*);
+		void eval_intrinsic_run(wpp::node_t, const IntrinsicRun&, wpp::Env&, wpp::FnEnv*, std::string&);
+		void eval_intrinsic_pipe(wpp::node_t, const IntrinsicPipe&, wpp::Env&, wpp::FnEnv*, std::string&);
+		void eval_intrinsic_log(wpp::node_t, const IntrinsicLog&, wpp::Env&, wpp::FnEnv*, std::string&);
+		void eval_intrinsic_error(wpp::node_t, const IntrinsicError&, wpp::Env&, wpp::FnEnv*, std::string&);
+		void eval_intrinsic_assert(wpp::node_t, const IntrinsicAssert&, wpp::Env&, wpp::FnEnv*, std::string&);
+		void eval_intrinsic_file(wpp::node_t, const IntrinsicFile&, wpp::Env&, wpp::FnEnv*, std::string&);
+		void eval_intrinsic_use(wpp::node_t, const IntrinsicUse&, wpp::Env&, wpp::FnEnv*, std::string&);
+
+		void eval_fninvoke(wpp::node_t, const FnInvoke&, wpp::Env&, wpp::FnEnv*, std::string&);
+		void eval_fn(wpp::node_t, const Fn&, wpp::Env&, wpp::FnEnv*, std::string&);
+		void eval_codeify(wpp::node_t, const Codeify&, wpp::Env&, wpp::FnEnv*, std::string&);
+		void eval_varref(wpp::node_t, const VarRef&, wpp::Env&, wpp::FnEnv*, std::string&);
+		void eval_var(wpp::node_t, const Var&, wpp::Env&, wpp::FnEnv*, std::string&);
+		void eval_pop(wpp::node_t, const Pop&, wpp::Env&, wpp::FnEnv*, std::string&);
+		void eval_drop(wpp::node_t, const Drop&, wpp::Env&, wpp::FnEnv*, std::string&);
+		void eval_string(wpp::node_t, const String&, wpp::Env&, wpp::FnEnv*, std::string&);
+		void eval_new(wpp::node_t, const New&, wpp::Env&, wpp::FnEnv*, std::string&);
+		void eval_cat(wpp::node_t, const Concat&, wpp::Env&, wpp::FnEnv*, std::string&);
+		void eval_slice(wpp::node_t, const Slice&, wpp::Env&, wpp::FnEnv*, std::string&);
+		void eval_block(wpp::node_t, const Block&, wpp::Env&, wpp::FnEnv*, std::string&);
+		void eval_match(wpp::node_t, const Match&, wpp::Env&, wpp::FnEnv*, std::string&);
+		void eval_document(wpp::node_t, const Document&, wpp::Env&, wpp::FnEnv*, std::string&);
 	}
 }
 
 
-// Utils
 namespace wpp { namespace {
-	wpp::Fn find_func(
+	// Conservatively check whether evaluating a node could do anything other
+	// than produce output. Calls are not followed here, instead an impure
+	// callee taints its callers at runtime (see `memo_begin`).
+	bool has_effects(wpp::node_t node_id, const wpp::Env& env) {
+		const auto effects = [&] (wpp::node_t node) {
+			return has_effects(node, env);
+		};
+
+		return wpp::visit(env.ast[node_id],
+			[&] (const IntrinsicError& x)  { return effects(x.expr); },
+			[&] (const IntrinsicAssert& x) { return effects(x.lhs) or effects(x.rhs); },
+
+			[&] (const FnInvoke& x) {
+				const auto args = env.ast.list(x.arguments);
+				return std::any_of(args.begin(), args.end(), effects);
+			},
+			[&] (const VarRef& x)   { return x.slot == -1; },   // Variables can be redefined at any time.
+			[&] (const String&)     { return false; },
+			[&] (const Concat& x)   { return effects(x.lhs) or effects(x.rhs); },
+			[&] (const Slice& x)    { return effects(x.expr); },
+			[&] (const New& x)      { return effects(x.expr); },
+
+			[&] (const Block& x) {
+				const auto stmts = env.ast.list(x.statements);
+				return effects(x.expr) or std::any_of(stmts.begin(), stmts.end(), effects);
+			},
+
+			[&] (const Match& x) {
+				const auto cases = env.ast.list(x.cases);
+
+				return
+					effects(x.expr) or
+					(x.default_case != wpp::NODE_EMPTY and effects(x.default_case)) or
+					std::any_of(cases.begin(), cases.end(), effects);
+			},
+
+			// Definitions, `drop`, `pop`, `!` and intrinsics which touch the
+			// outside world.
+			[&] (const auto&) { return true; }
+		);
+	}
+}}
+
+
+// Utils
+// These are shared between the tree walking evaluator and the vm.
+namespace wpp {
+	wpp::node_t find_func(
 		wpp::node_t node_id,
-		const View& name,
+		const wpp::symbol_t symbol,
 		size_t n_args,
 		wpp::Env& env
 	) {
 		DBG();
 
 		auto& functions = env.functions;
+		auto& caches = env.call_caches;
 		const auto& ast = env.ast;
 		const auto& flags = env.flags;
 
+		// Check if this call site has already been resolved and no function
+		// has been defined or dropped since.
+		if (static_cast<size_t>(node_id) < caches.size()) {
+			const auto& cache = caches[node_id];
+
+			if (cache.func != wpp::NODE_EMPTY and cache.epoch == env.epoch and cache.n_args == n_args)
+				return cache.func;
+		}
+
 		// Lookup function which accepts at least n_args.
-		if (auto it = functions.find(name); it != functions.end()) {
-			auto& arities = it->second;
+		if (symbol < functions.size()) {
+			auto& arities = functions[symbol];
 
 			if (auto arity_it = arities.lower_bound(n_args); arity_it != arities.end()) {
 				auto& [min_args, entry] = *arity_it;
@@ -70,75 +128,63 @@ namespace wpp { namespace {
 						"this may be intentional behaviour, extra arguments will be pushed to the stack"
 					);
 
-				return ast.get<wpp::Fn>(entry.back());
+				if (static_cast<size_t>(node_id) >= caches.size())
+					caches.resize(ast.size());
+
+				caches[node_id] = wpp::CallCache{ env.epoch, n_args, entry.back() };
+
+				return entry.back();
 			}
 		}
 
 		// No function found.
 		wpp::error(report_modes::semantic, node_id, env, "function not found",
-			wpp::cat("attempting to invoke function '", name, "' (", n_args, " parameters) which is undefined"),
+			wpp::cat("attempting to invoke function '", env.symbols.name(symbol), "' (", n_args, " parameters) which is undefined"),
 			"are you passing the correct number of arguments?"
 		);
 	}
 
 
-	std::string call_func(
+	wpp::node_t setup_call(
 		wpp::node_t node_id,
-		const View& name,
-		std::vector<std::string>& arg_strings,
+		const wpp::symbol_t symbol,
+		std::vector<wpp::Str>& strs,
+		size_t base,
 		wpp::Env& env,
-		wpp::FnEnv* fn_env
+		wpp::FnEnv& new_fn_env
 	) {
 		DBG();
 
-		auto& functions = env.functions;
-		const auto& ast = env.ast;
 		const auto& flags = env.flags;
 
-		wpp::Fn func = wpp::find_func(node_id, name, arg_strings.size(), env);
-
-
-		// Set up Arguments to pass down to function body.
-		wpp::FnEnv new_fn_env;
-
-		new_fn_env.arguments.emplace_back();
-
-		if (fn_env)
-			new_fn_env.arguments.back() = fn_env->arguments.back();
-
+		const wpp::node_t func_id = wpp::find_func(node_id, symbol, strs.size() - base, env);
+		const auto& func = env.ast.get<wpp::Fn>(func_id);
 
+		const auto n_params = func.parameters.size;
 
-		const auto& params = func.parameters;
 
 		// Handle variadic arguments.
-		auto it = arg_strings.begin();
-
-		for (; it != arg_strings.end() - params.size(); ++it)
-			env.stack.back().emplace_back(*it);
+		for (auto it = strs.begin() + base; it != strs.end() - n_params; ++it)
+			env.stack.back().emplace_back(std::move(*it));
 
 
 		// Setup normal arguments.
-		for (auto rit = params.rbegin(); rit != params.rend() and it != arg_strings.end(); ++rit, ++it) {
-			const auto arg_it = new_fn_env.arguments.back().find(*rit);
+		// Arguments are in reverse order so the first parameter is bound
+		// to the last string.
+		new_fn_env = wpp::FnEnv{ func_id, env.arguments.size() };
 
-			// If parameter is not already in environment, insert it.
-			if (arg_it == new_fn_env.arguments.back().end())
-				new_fn_env.arguments.back().emplace(*rit, *it);
+		if (env.arguments.size() + n_params > env.arguments.capacity())
+			env.stats.arg_allocs++;
 
-			// If parameter exists, overwrite it.
-			else {
-				arg_it->second = *it;
+		for (auto rit = strs.rbegin(); rit != strs.rbegin() + n_params; ++rit)
+			env.arguments.emplace_back(std::move(*rit));
 
-				if (flags & wpp::WARN_PARAM_SHADOW_PARAM and not wpp::is_previously_seen_warning(WARN_PARAM_SHADOW_PARAM, node_id, env))
-					wpp::warning(report_modes::semantic, node_id, env, "parameter shadows parameter",
-						wpp::cat("parameter '", arg_it->first, "' inside function '", name, "' shadows parameter from enclosing function")
-					);
-			}
-		}
+		strs.erase(strs.begin() + base, strs.end());
 
 
 		// Call function.
 		env.call_depth++;
+		wpp::retain_region(func_id, env);
 
 		if (
 			flags & wpp::WARN_DEEP_RECURSION and
@@ -150,189 +196,219 @@ namespace wpp { namespace {
 				"this may indicate recursion without an exit condition"
 			);
 
-		std::string str = evaluate(func.body, env, &new_fn_env);
+		return func.body;
+	}
 
-		env.call_depth--;
 
-		new_fn_env.arguments.pop_back();
+	void finish_call(const wpp::FnEnv& fn_env, wpp::Env& env) {
+		DBG();
 
-		return str;
+		env.arguments.erase(env.arguments.begin() + fn_env.base, env.arguments.end());
+		env.call_depth--;
+
+		wpp::release_region(fn_env.func, env);
 	}
-}}
 
 
-namespace wpp { namespace {
-	std::string eval_intrinsic_use(wpp::node_t node_id, const IntrinsicUse& use, wpp::Env& env, wpp::FnEnv* fn_env) {
+	bool is_pure(wpp::node_t func_id, wpp::Env& env) {
 		DBG();
-		return intrinsic_use(node_id, use.expr, env, fn_env);
-	}
 
-	std::string eval_intrinsic_file(wpp::node_t node_id, const IntrinsicFile& file, wpp::Env& env, wpp::FnEnv* fn_env) {
-		DBG();
-		return intrinsic_file(node_id, file.expr, env, fn_env);
-	}
+		auto& cache = env.purities;
 
-	std::string eval_intrinsic_run(wpp::node_t node_id, const IntrinsicRun& run, wpp::Env& env, wpp::FnEnv* fn_env) {
-		DBG();
-		return intrinsic_run(node_id, run.expr, env, fn_env);
-	}
+		if (static_cast<size_t>(func_id) >= cache.size())
+			cache.resize(env.ast.size(), purities::unknown);
 
-	std::string eval_intrinsic_pipe(wpp::node_t node_id, const IntrinsicPipe& pipe, wpp::Env& env, wpp::FnEnv* fn_env) {
-		DBG();
-		return intrinsic_pipe(node_id, pipe.cmd, pipe.value, env, fn_env);
-	}
+		if (cache[func_id] == purities::unknown)
+			cache[func_id] = wpp::has_effects(env.ast.get<Fn>(func_id).body, env) ? purities::impure : purities::pure;
 
-	std::string eval_intrinsic_assert(wpp::node_t node_id, const IntrinsicAssert& ass, wpp::Env& env, wpp::FnEnv* fn_env) {
-		DBG();
-		return intrinsic_assert(node_id, ass.lhs, ass.rhs, env, fn_env);
+		return cache[func_id] == purities::pure;
 	}
 
-	std::string eval_intrinsic_error(wpp::node_t node_id, const IntrinsicError& err, wpp::Env& env, wpp::FnEnv* fn_env) {
-		DBG();
-		return intrinsic_error(node_id, err.expr, env, fn_env);
-	}
 
-	std::string eval_intrinsic_log(wpp::node_t node_id, const IntrinsicLog& log, wpp::Env& env, wpp::FnEnv* fn_env) {
+	const wpp::Str* memo_begin(const wpp::FnEnv& fn_env, size_t n_args, wpp::Env& env, wpp::MemoFrame& frame) {
 		DBG();
-		return intrinsic_log(node_id, log.expr, env, fn_env);
-	}
 
+		if (not (env.flags & wpp::FLAG_MEMOIZE))
+			return nullptr;
 
-	std::string eval_fninvoke(wpp::node_t node_id, const FnInvoke& call, wpp::Env& env, wpp::FnEnv* fn_env) {
-		DBG();
+		frame.tainted = env.memo_taint;
 
-		// Evaluate arguments.
-		std::vector<std::string> arg_strings;
-		const auto& args = call.arguments;
+		// Extra arguments are pushed to the stack which is an effect of its own.
+		if (n_args != env.ast.get<Fn>(fn_env.func).parameters.size or not wpp::is_pure(fn_env.func, env)) {
+			env.stats.memo_impure++;
+			env.memo_taint = true;
+			return nullptr;
+		}
+
+		// Hashing is linear in the size of the arguments, large arguments are
+		// usually slices of the same string passed down a recursive loop.
+		size_t args_size = 0;
 
-		for (auto it = args.rbegin(); it != args.rend(); ++it)
-			arg_strings.emplace_back(wpp::evaluate(*it, env, fn_env));
+		for (auto it = env.arguments.begin() + fn_env.base; it != env.arguments.end(); ++it)
+			args_size += it->size();
 
-		return wpp::call_func(node_id, call.identifier, arg_strings, env, nullptr);
+		if (args_size > wpp::MAX_MEMO_ARGS_SIZE)
+			return nullptr;
+
+		// A result depends on whichever functions were called to produce it so
+		// the table is only valid until the next definition or drop.
+		if (env.memo_epoch != env.epoch) {
+			env.memo.clear();
+			env.memo_bytes = 0;
+			env.memo_epoch = env.epoch;
+		}
+
+		const wpp::MemoKey key{ fn_env.func, { env.arguments.begin() + fn_env.base, env.arguments.end() } };
+
+		if (auto it = env.memo.find(key); it != env.memo.end()) {
+			env.stats.memo_hits++;
+			return &it->second;
+		}
+
+		env.stats.memo_misses++;
+
+		env.memo_taint = false;
+		frame.active = true;
+
+		return nullptr;
 	}
 
 
-	std::string eval_fn(wpp::node_t node_id, const Fn& func, wpp::Env& env, wpp::FnEnv* fn_env) {
+	void memo_end(const wpp::FnEnv& fn_env, const wpp::Str& result, wpp::Env& env, const wpp::MemoFrame& frame) {
 		DBG();
 
-		auto& functions = env.functions;
-		const auto& flags = env.flags;
+		if (not (env.flags & wpp::FLAG_MEMOIZE))
+			return;
 
-		const auto& name = func.identifier;
-		const auto& params = func.parameters;
-		const auto n_params = params.size();
+		// Only store the result if nothing impure was called along the way.
+		if (frame.active and not env.memo_taint and env.memo_epoch == env.epoch) {
+			wpp::MemoKey key{ fn_env.func, { env.arguments.begin() + fn_env.base, env.arguments.end() } };
 
+			// The arguments and result may share their buffers with strings
+			// elsewhere but the table can keep them alive on its own.
+			size_t bytes = sizeof(wpp::MemoTable::value_type) + result.size() + key.args.size() * sizeof(wpp::Str);
 
-		// Check if function already exists.
-		if (auto it = functions.find(name); it != functions.end()) {
-			auto& arities = it->second;
+			for (const auto& arg: key.args)
+				bytes += arg.size();
 
-			if (auto arity_it = arities.find(n_params); arity_it != arities.end()) {
-				auto& generations = arity_it->second;
+			// When the table is full we start over, results are mostly used
+			// again by the calls close to the one which stored them.
+			const size_t limit = env.memory_budget / wpp::MEMO_BUDGET_SHARE;
 
-				if (flags & wpp::WARN_FUNC_REDEFINED and not wpp::is_previously_seen_warning(WARN_FUNC_REDEFINED, node_id, env))
-					wpp::warning(report_modes::semantic, node_id, env, "function redefined",
-						wpp::cat("function '", name, "' (>=", n_params, " parameters) redefined")
-					);
+			if (bytes <= limit) {
+				if (env.memo_bytes + bytes > limit)
+					wpp::memo_clear(env);
 
-				generations.emplace_back(node_id);
+				if (env.memo.insert_or_assign(std::move(key), result).second)
+					env.memo_bytes += bytes;
 			}
-
-			else
-				arities.emplace(n_params, std::initializer_list<node_t>{node_id});
 		}
 
-		// Otherwise, create it.
-		else
-			functions.emplace(name, std::map<size_t, std::vector<node_t>, std::greater<size_t>>{
-				{n_params, std::initializer_list<node_t>{node_id}}
-			});
-
-		return "";
+		env.memo_taint = env.memo_taint or frame.tainted;
 	}
 
 
-	std::string eval_codeify(wpp::node_t node_id, const Codeify& colby, wpp::Env& env, wpp::FnEnv* fn_env) {
+	void memo_clear(wpp::Env& env) {
 		DBG();
-		return wpp::intrinsic_eval(node_id, colby.expr, env, fn_env);
+
+		env.stats.memo_evicted += env.memo.size();
+
+		env.memo.clear();
+		env.memo_bytes = 0;
 	}
 
 
-	std::string eval_varref(wpp::node_t node_id, const VarRef& varref, wpp::Env& env, wpp::FnEnv* fn_env) {
-		DBG();
+	wpp::Region* find_region(wpp::node_t node_id, wpp::Env& env) {
+		auto& regions = env.regions;
 
-		const auto& flags = env.flags;
-		auto& variables = env.variables;
+		if (regions.empty() or node_id < regions.front().begin)
+			return nullptr;
 
-		const auto& name = varref.identifier;
+		auto it = std::upper_bound(regions.begin(), regions.end(), node_id, [] (wpp::node_t node, const auto& region) {
+			return node < region.begin;
+		});
 
+		--it;
 
-		// Check if parameter.
-		if (fn_env) {
-			if (const auto it = fn_env->arguments.back().find(name); it != fn_env->arguments.back().end()) {
-				// Check if it's shadowing a variable.
-				if (
-					flags & wpp::WARN_PARAM_SHADOW_VAR and
-					not wpp::is_previously_seen_warning(WARN_PARAM_SHADOW_VAR, node_id, env) and
-					variables.find(name) != variables.end()
-				)
-					wpp::warning(report_modes::semantic, node_id, env, "parameter shadows variable", wpp::cat("parameter '", name.str(), "' is shadowing a variable"));
+		if (node_id >= it->end)
+			return nullptr;
 
-				return it->second; // Return str.
-			}
-		}
+		return &*it;
+	}
 
-		// Check if variable.
-		if (const auto it = variables.find(name); it != variables.end())
-			return it->second;
 
-		wpp::error(report_modes::semantic, node_id, env, "variable not found",
-			wpp::cat("attempting to reference variable '", name.str(), "' which is undefined")
-		);
+	void retain_region(wpp::node_t node_id, wpp::Env& env) {
+		if (wpp::Region* region = wpp::find_region(node_id, env); region and region->refs++ == 0)
+			env.dead_regions--;
+	}
+
 
-		return "";
+	void release_region(wpp::node_t node_id, wpp::Env& env) {
+		if (wpp::Region* region = wpp::find_region(node_id, env); region and --region->refs == 0)
+			env.dead_regions++;
 	}
 
 
-	std::string eval_var(wpp::node_t node_id, const Var& var, wpp::Env& env, wpp::FnEnv* fn_env) {
+	bool reclaim_regions(wpp::Env& env) {
 		DBG();
 
-		const auto& flags = env.flags;
-		auto& variables = env.variables;
+		auto& regions = env.regions;
+		auto& ast = env.ast;
 
-		const auto name = var.identifier;
+		const size_t old_size = ast.size();
 
+		// Nodes are indices so only the end of the tree can be freed, a live
+		// region or anything parsed after a region keeps those below it.
+		while (
+			env.dead_regions > wpp::MAX_CACHED_EVALS and
+			not regions.empty() and
+			regions.back().refs == 0 and
+			static_cast<size_t>(regions.back().end) == ast.size()
+		) {
+			const wpp::Region& region = regions.back();
+			const auto begin = static_cast<size_t>(region.begin);
 
-		if (auto it = variables.find(name); it != variables.end()) {
-			if (flags & wpp::WARN_VAR_REDEFINED and not wpp::is_previously_seen_warning(WARN_VAR_REDEFINED, node_id, env))
-				wpp::warning(report_modes::semantic, node_id, env, "variable redefined", wpp::cat("variable '", name, "' redefined"));
+			env.eval_cache.erase(region.key);
 
-			it->second = wpp::evaluate(var.body, env, fn_env);
-		}
+			while (ast.size() > begin) {
+				ast.pop_back();
+				env.ast_meta.pop_back();
+			}
 
-		else
-			variables.emplace(name, wpp::evaluate(var.body, env, fn_env));
+			ast.pool.resize(region.pool_begin);
+			ast.strings.resize(region.strings_begin);
 
-		return "";
-	}
+			// Caches indexed by node would otherwise apply to new nodes.
+			if (env.call_caches.size() > begin)
+				env.call_caches.resize(begin);
 
+			if (env.purities.size() > begin)
+				env.purities.resize(begin);
 
-	std::string eval_pop(wpp::node_t node_id, const Pop& pop, wpp::Env& env, wpp::FnEnv* fn_env) {
-		DBG();
+			for (auto it = env.seen_warnings.begin(); it != env.seen_warnings.end();) {
+				if (static_cast<size_t>(it->first) >= begin)
+					it = env.seen_warnings.erase(it);
 
-		auto& stack = env.stack;
+				else
+					++it;
+			}
 
-		const auto& func = pop.identifier;
-		const auto& args = pop.arguments;
-		auto n_popped_args = pop.n_popped_args;
+			env.sources.erase(region.source);
 
+			regions.pop_back();
+			env.dead_regions--;
+			env.stats.eval_reclaimed++;
+		}
 
+		return ast.size() != old_size;
+	}
 
-		// Evaluate arguments.
-		std::vector<std::string> arg_strings;
 
-		for (auto it = args.begin(); it != args.end(); ++it)
-			arg_strings.emplace_back(wpp::evaluate(*it, env, fn_env));
+	void collect_popped_args(const Pop& pop, std::vector<wpp::Str>& strs, size_t base, wpp::Env& env) {
+		DBG();
+
+		auto& stack = env.stack;
+		auto n_popped_args = pop.n_popped_args;
 
 		// Loop to collect as many strings from the stack as possible until we reach `n_popped_args`
 		// or the stack is empty.
@@ -340,54 +416,77 @@ namespace wpp { namespace {
 			if (stack.back().empty())
 				break;
 
-			arg_strings.emplace_back(stack.back().back());
+			strs.emplace_back(std::move(stack.back().back()));
 			stack.back().pop_back();
 		}
 
-		std::reverse(arg_strings.begin(), arg_strings.end());
-
-		return wpp::call_func(node_id, func, arg_strings, env, nullptr);
+		std::reverse(strs.begin() + base, strs.end());
 	}
 
 
-	std::string eval_new(wpp::node_t node_id, const New& nnew, wpp::Env& env, wpp::FnEnv* fn_env) {
+	void define_func(wpp::node_t node_id, const Fn& func, wpp::Env& env) {
 		DBG();
 
-		env.stack.emplace_back();
-		const std::string str = wpp::evaluate(nnew.expr, env, fn_env);
-		env.stack.pop_back();
+		auto& functions = env.functions;
+		const auto& flags = env.flags;
 
-		return str;
+		const auto& name = env.symbols.name(func.symbol);
+		const auto n_params = func.parameters.size;
+
+		if (func.symbol >= functions.size())
+			functions.resize(env.symbols.size());
+
+		env.epoch++; // Invalidate call site caches.
+		wpp::retain_region(node_id, env);
+
+		auto& arities = functions[func.symbol];
+
+
+		// Check if function already exists.
+		if (auto arity_it = arities.find(n_params); arity_it != arities.end()) {
+			auto& generations = arity_it->second;
+
+			if (flags & wpp::WARN_FUNC_REDEFINED and not wpp::is_previously_seen_warning(WARN_FUNC_REDEFINED, node_id, env))
+				wpp::warning(report_modes::semantic, node_id, env, "function redefined",
+					wpp::cat("function '", name, "' (>=", n_params, " parameters) redefined")
+				);
+
+			generations.emplace_back(node_id);
+		}
+
+		// Otherwise, create it.
+		else
+			arities.emplace(n_params, std::initializer_list<node_t>{node_id});
 	}
 
 
-	std::string eval_drop(wpp::node_t node_id, const Drop& drop, wpp::Env& env, wpp::FnEnv* fn_env) {
+	void drop_func(wpp::node_t node_id, const Drop& drop, wpp::Env& env) {
 		DBG();
 
 		auto& functions = env.functions;
 
-		const auto& name = drop.identifier;
+		const auto& name = env.symbols.name(drop.symbol);
 		const auto n_args = drop.n_args;
 
-		if (auto it = functions.find(name); it != functions.end()) {
-			auto& arities = it->second;
+		if (drop.symbol < functions.size()) {
+			auto& arities = functions[drop.symbol];
 
 			if (auto arity_it = arities.find(n_args); arity_it != arities.end()) {
+				env.epoch++; // Invalidate call site caches.
+
 				// If we have found a function, drop the latest
 				// generation and return to a previous definition.
-				if (not arity_it->second.empty())
+				if (not arity_it->second.empty()) {
+					wpp::release_region(arity_it->second.back(), env);
 					arity_it->second.pop_back();
+				}
 
 				// If there are no generations, erase the entry.
 				if (arity_it->second.empty())
 					arities.erase(arity_it);
 
-				return "";
+				return;
 			}
-
-			// If no functions exist under this name, remove the entire entry.
-			if (arities.empty())
-				functions.erase(it);
 		}
 
 		wpp::error(report_modes::semantic, node_id, env, "undefined function",
@@ -397,35 +496,86 @@ namespace wpp { namespace {
 	}
 
 
-	std::string eval_string(wpp::node_t node_id, const String& str, wpp::Env& env, wpp::FnEnv* fn_env) {
+	const wpp::Str& lookup_var(wpp::node_t node_id, const VarRef& varref, wpp::Env& env, const wpp::FnEnv* fn_env) {
 		DBG();
-		return str.value;
+
+		const auto& flags = env.flags;
+		auto& variables = env.variables;
+
+		const auto& name = env.symbols.name(varref.symbol);
+		const auto symbol = varref.symbol;
+
+		const bool is_var = symbol < variables.size() and variables[symbol].has_value();
+
+
+		// Check if parameter.
+		if (fn_env) {
+			int32_t slot = varref.slot;
+
+			// References parsed at runtime by `!` or `use` could not be resolved
+			// ahead of time so we search the parameters of the current function.
+			if (slot == -1) {
+				const auto params = env.ast.list(env.ast.get<Fn>(fn_env->func).parameters);
+
+				if (auto it = std::find(params.begin(), params.end(), symbol); it != params.end())
+					slot = std::distance(params.begin(), it);
+			}
+
+			if (slot != -1) {
+				// Check if it's shadowing a variable.
+				if (
+					flags & wpp::WARN_PARAM_SHADOW_VAR and
+					not wpp::is_previously_seen_warning(WARN_PARAM_SHADOW_VAR, node_id, env) and
+					is_var
+				)
+					wpp::warning(report_modes::semantic, node_id, env, "parameter shadows variable", wpp::cat("parameter '", name.str(), "' is shadowing a variable"));
+
+				return env.arguments[fn_env->base + slot];
+			}
+		}
+
+		// Check if variable.
+		if (is_var)
+			return *variables[symbol];
+
+		wpp::error(report_modes::semantic, node_id, env, "variable not found",
+			wpp::cat("attempting to reference variable '", name.str(), "' which is undefined")
+		);
 	}
 
 
-	std::string eval_cat(wpp::node_t node_id, const Concat& cat, wpp::Env& env, wpp::FnEnv* fn_env) {
+	void define_var(wpp::node_t node_id, const Var& var, wpp::Str&& value, wpp::Env& env) {
 		DBG();
-		std::string str;
 
-		str += evaluate(cat.lhs, env, fn_env);
-		str += evaluate(cat.rhs, env, fn_env);
+		const auto& flags = env.flags;
+		auto& variables = env.variables;
 
-		return str;
+		const auto& name = env.symbols.name(var.symbol);
+
+		if (var.symbol >= variables.size())
+			variables.resize(env.symbols.size());
+
+		auto& slot = variables[var.symbol];
+
+
+		if (slot.has_value() and flags & wpp::WARN_VAR_REDEFINED and not wpp::is_previously_seen_warning(WARN_VAR_REDEFINED, node_id, env))
+			wpp::warning(report_modes::semantic, node_id, env, "variable redefined", wpp::cat("variable '", name, "' redefined"));
+
+		slot = std::move(value);
 	}
 
 
-	std::string eval_slice(wpp::node_t node_id, const Slice& s, wpp::Env& env, wpp::FnEnv* fn_env) {
+	wpp::Str slice_string(const Slice& s, const wpp::Str& str, wpp::Env& env) {
 		DBG();
-		std::string str = evaluate(s.expr, env, fn_env);
 
 		int start = 0, stop = 0;
 
 
 		if (s.set & Slice::SLICE_STOP)
-			stop = wpp::dec_to_int_view(s.stop);
+			stop = s.stop;
 
 		if (s.set & Slice::SLICE_START or s.set & Slice::SLICE_INDEX)
-			start = wpp::dec_to_int_view(s.start);
+			start = s.start;
 
 
 		if (start < 0)
@@ -439,138 +589,609 @@ namespace wpp { namespace {
 		stop = std::clamp(static_cast<std::string::size_type>(stop), 0ul, str.size() - 1);
 
 
+		// The result is always a substring so we share the buffer of the
+		// input rather than copying out of it.
+		const char* const begin = str.data();
+		const char* const end = str.data() + str.size();
+
+		// A substring of valid UTF-8 is valid unless it splits a codepoint.
+		const auto slice = [&] (size_t first, size_t n) {
+			const auto is_continuation = [] (char c) {
+				return (c & 0b11000000) == 0b10000000;
+			};
+
+			if (n and (is_continuation(begin[first]) or (first + n < str.size() and is_continuation(begin[first + n]))))
+				env.utf8_taint = true;
+
+			return str.slice(first, n);
+		};
+
 		// Just get character at index.
 		if (s.set & Slice::SLICE_INDEX) {
-			const char* const begin = str.data();
-			const char* const end = str.data() + str.size();
-
-			int i = 0;
+			size_t i = 0;
 			auto ptr = begin;
 
 			// We need to loop here because we're dealing with UTF-8.
-			for (; ptr != end and i != start; ptr = utf8::next(ptr))
+			for (; ptr != end and i != static_cast<size_t>(start); ptr = utf8::next(ptr))
 				++i;
 
-			return str.substr(i, utf8::codepoint_size(ptr));
+			// Past the last codepoint we take the single byte at `i`.
+			const size_t n = ptr == end ? 1 : utf8::codepoint_size(ptr);
+
+			return slice(i, std::min<size_t>(n, str.size() - i));
 		}
 
+		size_t first = 0;
+		size_t last = str.size();
+
 		// If we have a stop index, remove chars from the end of the string.
 		if (s.set & Slice::SLICE_STOP) {
-			const char* const begin = str.data();
-			const char* const end = str.data() + str.size();
-
-			int erase_from_back = 0;
+			size_t erase_from_back = 0;
 
 			// Translate stop index into UTF-8 index.
-			for (auto ptr = begin; ptr != end and erase_from_back != stop; ptr = utf8::next(ptr))
+			for (auto ptr = begin; ptr != end and erase_from_back != static_cast<size_t>(stop); ptr = utf8::next(ptr))
 				++erase_from_back;
 
-			str.erase(erase_from_back, std::string::npos);
+			last = erase_from_back;
 		}
 
 		// If we have a start index, remove chars from the beginning of the string.
 		if (s.set & Slice::SLICE_START) {
-			const char* const begin = str.data();
-			const char* const end = str.data() + str.size();
-
-			int erase_from_front = 0;
+			size_t erase_from_front = 0;
 
 			// Translate start index into UTF-8 index.
-			for (auto ptr = begin; ptr != end and erase_from_front != start; ptr = utf8::next(ptr))
-				++erase_from_front;
+			for (auto ptr = begin; ptr != begin + last and erase_from_front != static_cast<size_t>(start); ++erase_from_front) {
+				ptr = utf8::next(ptr);
+
+				// The stop split a codepoint and we stepped over it, count
+				// as if we went all the way to the start.
+				if (ptr > begin + last) {
+					erase_from_front = start;
+					break;
+				}
+			}
 
-			str.erase(0, erase_from_front);
+			first = erase_from_front;
 		}
 
+		// A start past the stop gives an empty string.
+		last = std::max(first, last);
 
-		return str;
+		return slice(first, last - first);
+	}
+}
+
+
+namespace wpp { namespace {
+	// Push an argument onto `Env::scratch`, counting the times it has to grow
+	// for `--stats`.
+	void push_arg(wpp::Str&& str, wpp::Env& env) {
+		if (env.scratch.size() == env.scratch.capacity())
+			env.stats.arg_allocs++;
+
+		env.scratch.emplace_back(std::move(str));
+	}
+
+
+	// Evaluate the arguments of a call onto `Env::scratch` and return the
+	// index they start at, see `setup_call`.
+	size_t eval_args(const FnInvoke& call, wpp::Env& env, wpp::FnEnv* fn_env) {
+		DBG();
+
+		const size_t base = env.scratch.size();
+		const auto args = env.ast.list(call.arguments);
+
+		for (size_t i = args.size(); i > 0; --i) {
+			wpp::Str str = wpp::evaluate(args[i - 1], env, fn_env);
+			wpp::push_arg(std::move(str), env);
+		}
+
+		return base;
 	}
 
 
-	std::string eval_block(wpp::node_t node_id, const Block& block, wpp::Env& env, wpp::FnEnv* fn_env) {
+	size_t eval_args(const Pop& pop, wpp::Env& env, wpp::FnEnv* fn_env) {
 		DBG();
 
-		for (const wpp::node_t node: block.statements)
-			evaluate(node, env, fn_env);
+		const size_t base = env.scratch.size();
 
-		return evaluate(block.expr, env, fn_env);
+		for (const wpp::node_t arg: env.ast.list(pop.arguments)) {
+			wpp::Str str = wpp::evaluate(arg, env, fn_env);
+			wpp::push_arg(std::move(str), env);
+		}
+
+		wpp::collect_popped_args(pop, env.scratch, base, env);
+
+		return base;
 	}
 
 
-	std::string eval_match(wpp::node_t node_id, const Match& match, wpp::Env& env, wpp::FnEnv* fn_env) {
+	void eval_statements(const Block& block, wpp::Env& env, wpp::FnEnv* fn_env) {
+		DBG();
+
+		// Output of statements is discarded, we reuse a single buffer for them.
+		std::string discard;
+
+		for (const wpp::node_t node: env.ast.list(block.statements)) {
+			evaluate(node, env, fn_env, discard);
+			discard.clear();
+		}
+	}
+
+
+	// Find the hand of a match expression to evaluate.
+	wpp::node_t select_hand(wpp::node_t node_id, const Match& match, wpp::Env& env, wpp::FnEnv* fn_env) {
 		DBG();
-		std::string str;
 
 		const auto& test = match.expr;
-		const auto& cases = match.cases;
+		const auto cases = env.ast.list(match.cases);
 		const auto& default_case = match.default_case;
 
 		const auto test_str = evaluate(test, env, fn_env);
 
 		// Compare test_str with arms of the match.
-		auto it = std::find_if(cases.begin(), cases.end(), [&] (const auto& elem) {
-			return test_str == evaluate(elem.first, env, fn_env);
-		});
-
-		// If found, evaluate the hand.
-		if (it != cases.end())
-			str = evaluate(it->second, env, fn_env);
+		for (size_t i = 0; i < cases.size(); i += 2) {
+			if (test_str == evaluate(cases[i], env, fn_env))
+				return cases[i + 1];
+		}
 
 		// If not found, check for a default arm, otherwise error.
-		else {
-			if (default_case == wpp::NODE_EMPTY)
-				wpp::error(report_modes::semantic, node_id, env, "no matches found",
-					"exhausted all checks in match expression"
-				);
+		if (default_case == wpp::NODE_EMPTY)
+			wpp::error(report_modes::semantic, node_id, env, "no matches found",
+				"exhausted all checks in match expression"
+			);
+
+		return default_case;
+	}
+
+
+	// Evaluate everything leading up to the expression in tail position of
+	// `node_id` and return it: the trailing expression of a block, the selected
+	// arm of a match and, when writing to a sink, the right side of `..`.
+	wpp::node_t find_tail(wpp::node_t node_id, wpp::Env& env, wpp::FnEnv* fn_env, std::string* out) {
+		DBG();
+
+		while (true) {
+			const auto node = env.ast[node_id];   // See `evaluate`.
+
+			if (const auto* block = std::get_if<Block>(&node)) {
+				wpp::eval_statements(*block, env, fn_env);
+				node_id = block->expr;
+			}
+
+			else if (const auto* match = std::get_if<Match>(&node))
+				node_id = wpp::select_hand(node_id, *match, env, fn_env);
+
+			else if (const auto* cat = std::get_if<Concat>(&node); cat and out) {
+				evaluate(cat->lhs, env, fn_env, *out);
+				node_id = cat->rhs;
+			}
 
 			else
-				str = evaluate(default_case, env, fn_env);
+				return node_id;
 		}
+	}
 
-		return str;
+
+	// The tree walker recurses on the native stack which is bounded by the
+	// stack limit of the process as well as by `Env::memory_budget`.
+	size_t native_stack_limit() {
+		static const size_t limit = [] {
+			size_t size = 8 * 1024 * 1024;
+			struct rlimit rlim;
+
+			if (getrlimit(RLIMIT_STACK, &rlim) == 0 and rlim.rlim_cur != RLIM_INFINITY)
+				size = rlim.rlim_cur;
+
+			return size / 4 * 3;   // Leave room for anything that recurses between checks.
+		}();
+
+		return limit;
+	}
+
+
+	void check_native_stack(wpp::node_t node_id, wpp::Env& env) {
+		char marker{};
+
+		const uintptr_t here = reinterpret_cast<uintptr_t>(&marker);
+		const size_t used = env.native_stack_base > here ? env.native_stack_base - here : here - env.native_stack_base;
+		const size_t limit = std::min(wpp::native_stack_limit(), env.memory_budget);
+
+		if (used + env.memo_bytes > env.memory_budget)
+			wpp::memo_clear(env);
+
+		if (used > limit)
+			wpp::error(report_modes::semantic, node_id, env, "stack exhausted",
+				wpp::cat("recursion used more than ", limit, " bytes of native stack"),
+				"without --tree the vm keeps its stack on the heap and is only limited by --memory-budget"
+			);
 	}
 
 
-	std::string eval_document(wpp::node_t node_id, const Document& doc, wpp::Env& env, wpp::FnEnv* fn_env) {
+	// A call in tail position replaces the frame of the caller rather than
+	// creating a new one so that recursion in tail position runs in constant
+	// space. Returns false if `node_id` is not a call.
+	bool tail_call(wpp::node_t& node_id, wpp::Env& env, wpp::FnEnv& fn_env, wpp::MemoFrame& memo, size_t& n_args) {
 		DBG();
 
-		std::string str;
+		size_t base{};
+		wpp::symbol_t symbol{};
+
+		// The arguments may contain a `!` which moves the tree, and the
+		// popped arguments are only collected after them. See `evaluate`.
+		const auto node = env.ast[node_id];
+
+		if (const auto* call = std::get_if<FnInvoke>(&node)) {
+			symbol = call->symbol;
+			base = wpp::eval_args(*call, env, &fn_env);
+		}
+
+		else if (const auto* pop = std::get_if<Pop>(&node)) {
+			symbol = pop->symbol;
+			base = wpp::eval_args(*pop, env, &fn_env);
+		}
+
+		else
+			return false;
+
+		// The result of the caller is no longer ours to store.
+		memo.active = false;
+		wpp::memo_end(fn_env, wpp::Str{}, env, memo);
+		wpp::finish_call(fn_env, env);
+
+		n_args = env.scratch.size() - base;
+		node_id = wpp::setup_call(node_id, symbol, env.scratch, base, env, fn_env);
+
+		memo = wpp::MemoFrame{};
+
+		return true;
+	}
 
-		for (const wpp::node_t node: doc.statements)
-			str += evaluate(node, env, fn_env);
+
+	wpp::Str call_func(
+		wpp::node_t node_id,
+		const wpp::symbol_t symbol,
+		size_t base,
+		wpp::Env& env
+	) {
+		DBG();
+
+		wpp::check_native_stack(node_id, env);
+
+		size_t n_args = env.scratch.size() - base;
+
+		wpp::FnEnv new_fn_env;
+		wpp::node_t node = wpp::setup_call(node_id, symbol, env.scratch, base, env, new_fn_env);
+
+		wpp::MemoFrame memo;
+
+		do {
+			if (const wpp::Str* result = wpp::memo_begin(new_fn_env, n_args, env, memo)) {
+				wpp::finish_call(new_fn_env, env);
+				return *result;
+			}
+
+			node = wpp::find_tail(node, env, &new_fn_env, nullptr);
+		} while (wpp::tail_call(node, env, new_fn_env, memo, n_args));
+
+		wpp::Str str = evaluate(node, env, &new_fn_env);
+
+		wpp::memo_end(new_fn_env, str, env, memo);
+		wpp::finish_call(new_fn_env, env);
 
 		return str;
 	}
+
+
+	void call_func(
+		wpp::node_t node_id,
+		const wpp::symbol_t symbol,
+		size_t base,
+		wpp::Env& env,
+		std::string& out
+	) {
+		DBG();
+
+		wpp::check_native_stack(node_id, env);
+
+		size_t n_args = env.scratch.size() - base;
+
+		wpp::FnEnv new_fn_env;
+		wpp::node_t node = wpp::setup_call(node_id, symbol, env.scratch, base, env, new_fn_env);
+
+		wpp::MemoFrame memo;
+		size_t start = 0;
+
+		do {
+			if (const wpp::Str* result = wpp::memo_begin(new_fn_env, n_args, env, memo)) {
+				out += *result;
+				wpp::finish_call(new_fn_env, env);
+				return;
+			}
+
+			start = out.size();
+			node = wpp::find_tail(node, env, &new_fn_env, &out);
+		} while (wpp::tail_call(node, env, new_fn_env, memo, n_args));
+
+		evaluate(node, env, &new_fn_env, out);
+
+		// Output since the start of the call is the result of the callee.
+		wpp::memo_end(new_fn_env,
+			memo.active ? wpp::Str{ std::string_view{out}.substr(start) } : wpp::Str{},
+			env, memo
+		);
+
+		wpp::finish_call(new_fn_env, env);
+	}
+}}
+
+
+namespace wpp { namespace {
+	void eval_intrinsic_use(wpp::node_t node_id, const IntrinsicUse& use, wpp::Env& env, wpp::FnEnv* fn_env, std::string& out) {
+		DBG();
+
+		std::filesystem::path old_path;
+		const wpp::node_t root = wpp::intrinsic_use(node_id, evaluate(use.expr, env, fn_env), env, old_path);
+
+		if (root == wpp::NODE_EMPTY)
+			return;
+
+		try {
+			evaluate(root, env, fn_env, out);
+		}
+
+		catch (const wpp::Report&) {
+			env.state |=
+				wpp::ABORT_EVALUATION |
+				wpp::ERROR_MODE_EVAL;
+
+			throw;
+		}
+
+		std::filesystem::current_path(old_path);
+	}
+
+	void eval_intrinsic_file(wpp::node_t node_id, const IntrinsicFile& file, wpp::Env& env, wpp::FnEnv* fn_env, std::string& out) {
+		DBG();
+		wpp::output(out, wpp::intrinsic_file(node_id, evaluate(file.expr, env, fn_env), env), env);
+	}
+
+	void eval_intrinsic_run(wpp::node_t node_id, const IntrinsicRun& run, wpp::Env& env, wpp::FnEnv* fn_env, std::string& out) {
+		DBG();
+		out += wpp::intrinsic_run(node_id, evaluate(run.expr, env, fn_env), env);
+	}
+
+	void eval_intrinsic_pipe(wpp::node_t node_id, const IntrinsicPipe& pipe, wpp::Env& env, wpp::FnEnv* fn_env, std::string& out) {
+		DBG();
+
+		const auto cmd = evaluate(pipe.cmd, env, fn_env);
+		const auto data = evaluate(pipe.value, env, fn_env);
+
+		out += wpp::intrinsic_pipe(node_id, cmd, data, env);
+	}
+
+	void eval_intrinsic_assert(wpp::node_t node_id, const IntrinsicAssert& ass, wpp::Env& env, wpp::FnEnv* fn_env, std::string& out) {
+		DBG();
+
+		const auto str_a = evaluate(ass.lhs, env, fn_env);
+		const auto str_b = evaluate(ass.rhs, env, fn_env);
+
+		wpp::intrinsic_assert(node_id, str_a, str_b, env);
+	}
+
+	void eval_intrinsic_error(wpp::node_t node_id, const IntrinsicError& err, wpp::Env& env, wpp::FnEnv* fn_env, std::string& out) {
+		DBG();
+		wpp::intrinsic_error(node_id, evaluate(err.expr, env, fn_env), env);
+	}
+
+	void eval_intrinsic_log(wpp::node_t node_id, const IntrinsicLog& log, wpp::Env& env, wpp::FnEnv* fn_env, std::string& out) {
+		DBG();
+		wpp::intrinsic_log(node_id, evaluate(log.expr, env, fn_env), env);
+	}
+
+
+	void eval_fninvoke(wpp::node_t node_id, const FnInvoke& call, wpp::Env& env, wpp::FnEnv* fn_env, std::string& out) {
+		DBG();
+
+		const size_t base = wpp::eval_args(call, env, fn_env);
+		wpp::call_func(node_id, call.symbol, base, env, out);
+	}
+
+
+	void eval_fn(wpp::node_t node_id, const Fn& func, wpp::Env& env, wpp::FnEnv* fn_env, std::string& out) {
+		DBG();
+		wpp::define_func(node_id, func, env);
+	}
+
+
+	void eval_codeify(wpp::node_t node_id, const Codeify& colby, wpp::Env& env, wpp::FnEnv* fn_env, std::string& out) {
+		DBG();
+
+		const wpp::Str source = wpp::evaluate(colby.expr, env, fn_env);
+
+		try {
+			const wpp::node_t root = wpp::intrinsic_eval(node_id, source, env);
+
+			const wpp::RegionRef ref{ root, env };
+			wpp::evaluate(root, env, fn_env, out);
+		}
+
+		catch (const wpp::Report& e) {
+			wpp::intrinsic_eval_error(node_id, e, env);
+		}
+
+		wpp::reclaim_regions(env);
+	}
+
+
+	void eval_varref(wpp::node_t node_id, const VarRef& varref, wpp::Env& env, wpp::FnEnv* fn_env, std::string& out) {
+		DBG();
+		wpp::output(out, wpp::lookup_var(node_id, varref, env, fn_env), env);
+	}
+
+
+	void eval_var(wpp::node_t node_id, const Var& var, wpp::Env& env, wpp::FnEnv* fn_env, std::string& out) {
+		DBG();
+		wpp::define_var(node_id, var, wpp::evaluate(var.body, env, fn_env), env);
+	}
+
+
+	void eval_pop(wpp::node_t node_id, const Pop& pop, wpp::Env& env, wpp::FnEnv* fn_env, std::string& out) {
+		DBG();
+
+		const size_t base = wpp::eval_args(pop, env, fn_env);
+		wpp::call_func(node_id, pop.symbol, base, env, out);
+	}
+
+
+	void eval_new(wpp::node_t node_id, const New& nnew, wpp::Env& env, wpp::FnEnv* fn_env, std::string& out) {
+		DBG();
+
+		env.stack.emplace_back();
+		wpp::evaluate(nnew.expr, env, fn_env, out);
+		env.stack.pop_back();
+	}
+
+
+	void eval_drop(wpp::node_t node_id, const Drop& drop, wpp::Env& env, wpp::FnEnv* fn_env, std::string& out) {
+		DBG();
+
+		wpp::drop_func(node_id, drop, env);
+		wpp::reclaim_regions(env);
+	}
+
+
+	void eval_string(wpp::node_t node_id, const String& str, wpp::Env& env, wpp::FnEnv* fn_env, std::string& out) {
+		DBG();
+		out += env.ast.string(str);
+	}
+
+
+	void eval_cat(wpp::node_t node_id, const Concat& cat, wpp::Env& env, wpp::FnEnv* fn_env, std::string& out) {
+		DBG();
+
+		// Both sides append straight into the sink so a chain of `..` is linear
+		// in the size of its output.
+		evaluate(cat.lhs, env, fn_env, out);
+		evaluate(cat.rhs, env, fn_env, out);
+	}
+
+
+	void eval_slice(wpp::node_t node_id, const Slice& s, wpp::Env& env, wpp::FnEnv* fn_env, std::string& out) {
+		DBG();
+		out += wpp::slice_string(s, evaluate(s.expr, env, fn_env), env);
+	}
+
+
+	void eval_block(wpp::node_t node_id, const Block& block, wpp::Env& env, wpp::FnEnv* fn_env, std::string& out) {
+		DBG();
+
+		wpp::eval_statements(block, env, fn_env);
+		evaluate(block.expr, env, fn_env, out);
+	}
+
+
+	void eval_match(wpp::node_t node_id, const Match& match, wpp::Env& env, wpp::FnEnv* fn_env, std::string& out) {
+		DBG();
+		evaluate(wpp::select_hand(node_id, match, env, fn_env), env, fn_env, out);
+	}
+
+
+	void eval_document(wpp::node_t node_id, const Document& doc, wpp::Env& env, wpp::FnEnv* fn_env, std::string& out) {
+		DBG();
+
+		for (const wpp::node_t node: env.ast.list(doc.statements))
+			evaluate(node, env, fn_env, out);
+	}
 }}
 
 
 namespace wpp {
 	// The core of the evaluator.
-	std::string evaluate(const wpp::node_t node_id, wpp::Env& env, wpp::FnEnv* fn_env) {
-		return wpp::visit(env.ast[node_id],
-			[&] (const IntrinsicRun& x)    { return eval_intrinsic_run    (node_id, x, env, fn_env); },
-			[&] (const IntrinsicPipe& x)   { return eval_intrinsic_pipe   (node_id, x, env, fn_env); },
-			[&] (const IntrinsicError& x)  { return eval_intrinsic_error  (node_id, x, env, fn_env); },
-			[&] (const IntrinsicLog& x)    { return eval_intrinsic_log    (node_id, x, env, fn_env); },
-			[&] (const IntrinsicAssert& x) { return eval_intrinsic_assert (node_id, x, env, fn_env); },
-			[&] (const IntrinsicFile& x)   { return eval_intrinsic_file   (node_id, x, env, fn_env); },
-			[&] (const IntrinsicUse& x)    { return eval_intrinsic_use    (node_id, x, env, fn_env); },
-
-			[&] (const FnInvoke& x) { return eval_fninvoke (node_id, x, env, fn_env); },
-			[&] (const Fn& x)       { return eval_fn       (node_id, x, env, fn_env); },
-			[&] (const Codeify& x)  { return eval_codeify  (node_id, x, env, fn_env); },
-			[&] (const VarRef& x)   { return eval_varref   (node_id, x, env, fn_env); },
-			[&] (const Var& x)      { return eval_var      (node_id, x, env, fn_env); },
-			[&] (const Pop& x)      { return eval_pop      (node_id, x, env, fn_env); },
-			[&] (const New& x)      { return eval_new      (node_id, x, env, fn_env); },
-			[&] (const Drop& x)     { return eval_drop     (node_id, x, env, fn_env); },
-			[&] (const String& x)   { return eval_string   (node_id, x, env, fn_env); },
-			[&] (const Concat& x)   { return eval_cat      (node_id, x, env, fn_env); },
-			[&] (const Slice& x)    { return eval_slice    (node_id, x, env, fn_env); },
-			[&] (const Block& x)    { return eval_block    (node_id, x, env, fn_env); },
-			[&] (const Match& x)    { return eval_match    (node_id, x, env, fn_env); },
-			[&] (const Document& x) { return eval_document (node_id, x, env, fn_env); }
+	// Output is appended to `out` rather than returned so that nodes which only
+	// forward their output (concatenation, blocks, calls...) never copy it.
+	void evaluate(const wpp::node_t node_id, wpp::Env& env, wpp::FnEnv* fn_env, std::string& out) {
+		// Handlers get a copy of the node. `!` parses new code into the tree
+		// while it is being evaluated which can move every node in it, so a
+		// reference into `env.ast` must not be held across a nested evaluate.
+		const auto node = env.ast[node_id];
+
+		wpp::visit(node,
+			[&] (const IntrinsicRun& x)    { return eval_intrinsic_run    (node_id, x, env, fn_env, out); },
+			[&] (const IntrinsicPipe& x)   { return eval_intrinsic_pipe   (node_id, x, env, fn_env, out); },
+			[&] (const IntrinsicError& x)  { return eval_intrinsic_error  (node_id, x, env, fn_env, out); },
+			[&] (const IntrinsicLog& x)    { return eval_intrinsic_log    (node_id, x, env, fn_env, out); },
+			[&] (const IntrinsicAssert& x) { return eval_intrinsic_assert (node_id, x, env, fn_env, out); },
+			[&] (const IntrinsicFile& x)   { return eval_intrinsic_file   (node_id, x, env, fn_env, out); },
+			[&] (const IntrinsicUse& x)    { return eval_intrinsic_use    (node_id, x, env, fn_env, out); },
+
+			[&] (const FnInvoke& x) { return eval_fninvoke (node_id, x, env, fn_env, out); },
+			[&] (const Fn& x)       { return eval_fn       (node_id, x, env, fn_env, out); },
+			[&] (const Codeify& x)  { return eval_codeify  (node_id, x, env, fn_env, out); },
+			[&] (const VarRef& x)   { return eval_varref   (node_id, x, env, fn_env, out); },
+			[&] (const Var& x)      { return eval_var      (node_id, x, env, fn_env, out); },
+			[&] (const Pop& x)      { return eval_pop      (node_id, x, env, fn_env, out); },
+			[&] (const New& x)      { return eval_new      (node_id, x, env, fn_env, out); },
+			[&] (const Drop& x)     { return eval_drop     (node_id, x, env, fn_env, out); },
+			[&] (const String& x)   { return eval_string   (node_id, x, env, fn_env, out); },
+			[&] (const Concat& x)   { return eval_cat      (node_id, x, env, fn_env, out); },
+			[&] (const Slice& x)    { return eval_slice    (node_id, x, env, fn_env, out); },
+			[&] (const Block& x)    { return eval_block    (node_id, x, env, fn_env, out); },
+			[&] (const Match& x)    { return eval_match    (node_id, x, env, fn_env, out); },
+			[&] (const Document& x) { return eval_document (node_id, x, env, fn_env, out); }
 		);
 	}
-}
 
+
+	// Evaluate a node into a standalone value. Used where a value is needed on
+	// its own such as arguments, match tests and variable bodies.
+	// Nodes which only forward an existing value (literals, variables, calls,
+	// slices...) share it rather than copying it.
+	wpp::Str evaluate(const wpp::node_t node_id, wpp::Env& env, wpp::FnEnv* fn_env) {
+		const auto node = env.ast[node_id];   // See above.
+
+		return wpp::visit(node,
+			[&] (const String& x) { return env.ast.string(x); },
+			[&] (const VarRef& x) { return wpp::lookup_var(node_id, x, env, fn_env); },
+			[&] (const Slice& x)  { return wpp::slice_string(x, evaluate(x.expr, env, fn_env), env); },
+
+			[&] (const FnInvoke& x) {
+				const size_t base = wpp::eval_args(x, env, fn_env);
+				return wpp::call_func(node_id, x.symbol, base, env);
+			},
+
+			[&] (const Pop& x) {
+				const size_t base = wpp::eval_args(x, env, fn_env);
+				return wpp::call_func(node_id, x.symbol, base, env);
+			},
+
+			[&] (const Block& x) {
+				wpp::eval_statements(x, env, fn_env);
+				return evaluate(x.expr, env, fn_env);
+			},
+
+			[&] (const Match& x) {
+				return evaluate(wpp::select_hand(node_id, x, env, fn_env), env, fn_env);
+			},
+
+			[&] (const New& x) {
+				env.stack.emplace_back();
+				wpp::Str str = evaluate(x.expr, env, fn_env);
+				env.stack.pop_back();
+
+				return str;
+			},
+
+			[&] (const IntrinsicFile& x) {
+				return wpp::intrinsic_file(node_id, evaluate(x.expr, env, fn_env), env);
+			},
+
+			// Everything else builds a new string.
+			[&] (const auto&) {
+				std::string str;
+				wpp::evaluate(node_id, env, fn_env, str);
+				return wpp::Str{std::move(str)};
+			}
+		);
+	}
+}
@@ -4,11 +4,89 @@
 #define WOTPP_EVAL
 
 #include <string>
+#include <vector>
 
+#include <structures/str.hpp>
 #include <structures/environment.hpp>
 
 namespace wpp {
-	std::string evaluate(const wpp::node_t, wpp::Env&, wpp::FnEnv* = nullptr);
+	// Append the output of a node to a caller provided sink.
+	void evaluate(const wpp::node_t, wpp::Env&, wpp::FnEnv*, std::string&);
+
+	// Evaluate a node into a standalone value which may share its buffer with
+	// literals, variables and arguments.
+	wpp::Str evaluate(const wpp::node_t, wpp::Env&, wpp::FnEnv* = nullptr);
+
+
+	// Semantics shared by the tree walking evaluator and the vm.
+
+	// Arguments of a call are built on top of a stack of values owned by the
+	// evaluator (`Env::scratch` for the tree walker, the value stack for the
+	// vm) starting at some base index, in reverse order.
+
+	// Resolve a function and move the arguments above `base` into a new
+	// argument frame, rewinding the value stack to `base`. Returns the body
+	// to evaluate. The caller must call `finish_call` once the body has been
+	// evaluated.
+	wpp::node_t setup_call(wpp::node_t, const wpp::symbol_t, std::vector<wpp::Str>&, size_t, wpp::Env&, wpp::FnEnv&);
+	void finish_call(const wpp::FnEnv&, wpp::Env&);
+
+	// Pop arguments off of the stack for `pop` and put the arguments above
+	// `base` in the order expected by `setup_call`.
+	void collect_popped_args(const Pop&, std::vector<wpp::Str>&, size_t, wpp::Env&);
+
+	// Memoization of pure functions, enabled by `FLAG_MEMOIZE`.
+	// `memo_begin` is called once the arguments of a call have been set up and
+	// returns the cached result if there is one. Otherwise the result must be
+	// handed to `memo_end` before calling `finish_call`.
+	struct MemoFrame {
+		bool active = false;    // The result of this call should be stored.
+		bool tainted = false;   // Taint of the enclosing call.
+	};
+
+	bool is_pure(wpp::node_t, wpp::Env&);
+	const wpp::Str* memo_begin(const wpp::FnEnv&, size_t, wpp::Env&, wpp::MemoFrame&);
+	void memo_end(const wpp::FnEnv&, const wpp::Str&, wpp::Env&, const wpp::MemoFrame&);
+
+	// The table is a cache so it is emptied rather than letting the stacks
+	// run out of memory budget.
+	void memo_clear(wpp::Env&);
+
+	// Regions of code parsed by `!`. Retaining or releasing a node outside of
+	// any region does nothing.
+	wpp::Region* find_region(wpp::node_t, wpp::Env&);
+	void retain_region(wpp::node_t, wpp::Env&);
+	void release_region(wpp::node_t, wpp::Env&);
+
+	// Keeps the region of a node retained until it goes out of scope, also
+	// when an error propagates through it.
+	struct RegionRef {
+		wpp::node_t node;
+		wpp::Env& env;
+
+		RegionRef(wpp::node_t node_, wpp::Env& env_): node(node_), env(env_) {
+			wpp::retain_region(node, env);
+		}
+
+		~RegionRef() {
+			wpp::release_region(node, env);
+		}
+
+		RegionRef(const RegionRef&) = delete;
+		RegionRef& operator=(const RegionRef&) = delete;
+	};
+
+	// Free unreferenced regions from the end of the tree once more than
+	// `MAX_CACHED_EVALS` of them are being kept. Returns true if the tree shrank.
+	bool reclaim_regions(wpp::Env&);
+
+	void define_func(wpp::node_t, const Fn&, wpp::Env&);
+	void drop_func(wpp::node_t, const Drop&, wpp::Env&);
+
+	const wpp::Str& lookup_var(wpp::node_t, const VarRef&, wpp::Env&, const wpp::FnEnv*);
+	void define_var(wpp::node_t, const Var&, wpp::Str&&, wpp::Env&);
+
+	wpp::Str slice_string(const Slice&, const wpp::Str&, wpp::Env&);
 }
 
 #endif
@@ -8,46 +8,85 @@
 #include <frontend/ast.hpp>
 #include <structures/environment.hpp>
 #include <frontend/parser/parser.hpp>
-#include <backend/eval/eval.hpp>
+#include <backend/eval/intrinsics.hpp>
 
 
 namespace wpp {
-	std::string intrinsic_eval(
+	wpp::node_t intrinsic_eval(
 		wpp::node_t node_id,
-		wpp::node_t expr,
-		wpp::Env& env,
-		wpp::FnEnv* fn_env
+		const wpp::Str& source,
+		wpp::Env& env
 	) {
 		DBG();
 
-		const std::string source = wpp::evaluate(expr, env, fn_env);
+		// Evaluating the same code again reuses the tree that was parsed the
+		// first time around instead of growing the AST.
+		if (auto it = env.eval_cache.find(source.view()); it != env.eval_cache.end()) {
+			env.stats.eval_hits++;
+			return it->second;
+		}
+
+		env.stats.eval_misses++;
+
+		// Without any strings of unknown encoding around, the code we were
+		// handed was built from valid UTF-8 and needn't be checked again.
+		const auto& src = env.sources.push(env.sources.top().file, source.str(), modes::eval, not env.utf8_taint);
+
+		const auto begin = static_cast<wpp::node_t>(env.ast.size());
+		const auto pool_begin = static_cast<uint32_t>(env.ast.pool.size());
+		const auto strings_begin = static_cast<uint32_t>(env.ast.strings.size());
 
-		const auto& [file, base, mode] = env.sources.top();
-		env.sources.push(file, source, modes::eval);
+		const std::string_view key{ src.base, source.size() };
 
-		std::string str;
+		// The new nodes are unreferenced until the caller starts evaluating
+		// them. A tree which fails to parse is never evaluated but it is kept
+		// as a region all the same so that `reclaim_regions` can free it.
+		const auto add_region = [&] {
+			env.regions.push_back(wpp::Region{
+				begin, static_cast<wpp::node_t>(env.ast.size()),
+				pool_begin, strings_begin,
+				&src, key
+			});
+			env.dead_regions++;
+		};
+
+		wpp::node_t root = wpp::NODE_EMPTY;
 
 		try {
-			str = wpp::evaluate(wpp::parse(env, node_id), env, fn_env);
+			root = wpp::parse(env, node_id);
 		}
 
-		catch (const wpp::Report& e) {
-			env.state |=
-				wpp::ABORT_EVALUATION |
-				wpp::ERROR_MODE_EVAL;
-
-			wpp::error(e.report_mode, node_id, env, e.overview, e.detail, e.suggestion);
+		catch (const wpp::Report&) {
+			add_region();
+			throw;
 		}
 
-		return str;
+		env.eval_cache.emplace(key, root);
+		add_region();
+
+		return root;
+	}
+
+
+	void intrinsic_eval_error(
+		wpp::node_t node_id,
+		const wpp::Report& e,
+		wpp::Env& env
+	) {
+		DBG();
+
+		env.state |=
+			wpp::ABORT_EVALUATION |
+			wpp::ERROR_MODE_EVAL;
+
+		wpp::error(e.report_mode, node_id, env, e.overview, e.detail, e.suggestion);
 	}
 
 
 	std::string intrinsic_run(
 		wpp::node_t node_id,
-		wpp::node_t expr,
-		wpp::Env& env,
-		wpp::FnEnv* fn_env
+		const wpp::Str& cmd,
+		wpp::Env& env
 	) {
 		DBG();
 
@@ -58,10 +97,8 @@ namespace wpp {
 			if (env.flags & wpp::FLAG_DISABLE_RUN)
 				wpp::error(report_modes::semantic, node_id, env, "intrinsic disabled", "`run` not available");
 
-			const auto cmd = wpp::evaluate(expr, env, fn_env);
-
 			int rc = 0;
-			std::string str = wpp::exec(cmd, rc);
+			std::string str = wpp::exec(cmd.str(), rc);
 
 			// trim trailing newline.
 			if (str.back() == '\n')
@@ -72,6 +109,7 @@ namespace wpp {
 					wpp::cat("subprocess exited with non-zero status `", cmd, "`")
 				);
 
+			wpp::track_utf8(str, env);
 			return str;
 		#endif
 	}
@@ -79,10 +117,9 @@ namespace wpp {
 
 	std::string intrinsic_pipe(
 		wpp::node_t node_id,
-		wpp::node_t cmd_id,
-		wpp::node_t value_id,
-		wpp::Env& env,
-		wpp::FnEnv* fn_env
+		const wpp::Str& cmd,
+		const wpp::Str& data,
+		wpp::Env& env
 	) {
 		DBG();
 
@@ -93,33 +130,28 @@ namespace wpp {
 			if (env.flags & wpp::FLAG_DISABLE_RUN)
 				wpp::error(report_modes::semantic, node_id, env, "intrinsic disabled", "`pipe` not available");
 
-			std::string str;
-
-			const auto cmd = evaluate(cmd_id, env, fn_env);
-			const auto data = evaluate(value_id, env, fn_env);
-
 			int rc = 0;
-			std::string out = wpp::exec(cmd, data, rc);
+			std::string str = wpp::exec(cmd.str(), data.str(), rc);
 
 			// trim trailing newline.
-			if (out.back() == '\n')
-				out.erase(out.end() - 1, out.end());
+			if (str.back() == '\n')
+				str.erase(str.end() - 1, str.end());
 
 			if (rc)
 				wpp::error(report_modes::semantic, node_id, env, "subcommand failed",
 					wpp::cat("subprocess exited with non-zero status `", cmd, "`")
 				);
 
-			return out;
+			wpp::track_utf8(str, env);
+			return str;
 		#endif
 	}
 
 
-	std::string intrinsic_file(
+	wpp::Str intrinsic_file(
 		wpp::node_t node_id,
-		wpp::node_t expr,
-		wpp::Env& env,
-		wpp::FnEnv* fn_env
+		const wpp::Str& fname,
+		wpp::Env& env
 	) {
 		DBG();
 
@@ -130,14 +162,12 @@ namespace wpp {
 			if (env.flags & wpp::FLAG_DISABLE_FILE)
 				wpp::error(report_modes::semantic, node_id, env, "intrinsic disabled", "`file` not available");
 
-			const auto fname = wpp::evaluate(expr, env, fn_env);
-
 			if (fname.empty())
 				wpp::error(report_modes::semantic, node_id, env, "empty path", "`file` must be supplied a non-empty string");
 
 			try {
 				try {
-					return wpp::read_file(std::filesystem::relative(std::filesystem::path{fname}));
+					return wpp::read_file_cached(std::filesystem::path{fname.view()}, env);
 				}
 
 				catch (const std::filesystem::filesystem_error&) {
@@ -169,16 +199,16 @@ namespace wpp {
 				);
 			}
 
-			return "";
+			return {};
 		#endif
 	}
 
 
-	std::string intrinsic_use(
+	wpp::node_t intrinsic_use(
 		wpp::node_t node_id,
-		wpp::node_t expr,
+		const wpp::Str& fname,
 		wpp::Env& env,
-		wpp::FnEnv* fn_env
+		std::filesystem::path& old_path
 	) {
 		DBG();
 
@@ -190,28 +220,25 @@ namespace wpp {
 				wpp::error(report_modes::semantic, node_id, env, "intrinsic disabled", "`use` not available");
 
 
-			std::string str;
-			const auto fname = wpp::evaluate(expr, env, fn_env);
-
 			if (fname.empty())
 				wpp::error(report_modes::semantic, node_id, env, "empty path", "`use` must be supplied a non-empty string");
 
-			std::filesystem::path old_path, new_path;
-			std::string source;
+			std::filesystem::path new_path;
+			wpp::Str source;
 
 			try {
 				try {
 					// Store current path and get the path of the new file.
 					old_path = std::filesystem::current_path();
-					new_path = old_path / wpp::get_file_path(fname, env.path);
+					new_path = old_path / wpp::get_file_path(fname.view(), env.path);
 
 					// Don't source something we've already seen.
 					if (env.sources.is_previously_seen(new_path))
-						return "";
+						return wpp::NODE_EMPTY;
 
 					std::filesystem::current_path(new_path.parent_path());
 
-					source = wpp::read_file(old_path / new_path);
+					source = wpp::read_source(old_path / new_path);
 				}
 
 				catch (const std::filesystem::filesystem_error&) {
@@ -244,70 +271,52 @@ namespace wpp {
 			}
 
 			try {
-				env.sources.push(new_path, source, wpp::modes::source);
-				str = wpp::evaluate(wpp::parse(env, node_id), env, fn_env);
+				env.sources.push(new_path, std::move(source), wpp::modes::source);
+				return wpp::parse(env, node_id);
 			}
 
 			catch (const wpp::Report& e) {
 				env.state |=
 					wpp::ABORT_EVALUATION |
 					wpp::ERROR_MODE_EVAL;
-				;
 
 				throw;
 			}
-
-			std::filesystem::current_path(old_path);
-
-			return str;
 		#endif
 	}
 
 
-	std::string intrinsic_assert(
+	void intrinsic_assert(
 		wpp::node_t node_id,
-		wpp::node_t lhs,
-		wpp::node_t rhs,
-		wpp::Env& env,
-		wpp::FnEnv* fn_env
+		const wpp::Str& str_a,
+		const wpp::Str& str_b,
+		wpp::Env& env
 	) {
 		DBG();
 
 		// Check if strings are equal.
-		const auto str_a = evaluate(lhs, env, fn_env);
-		const auto str_b = evaluate(rhs, env, fn_env);
-
 		if (str_a != str_b)
 			wpp::error(report_modes::semantic, node_id, env, "assertion failed", wpp::cat("lhs='", str_a, "', rhs='", str_b, "'"));
-
-		return "";
 	}
 
 
-	std::string intrinsic_error(
+	void intrinsic_error(
 		wpp::node_t node_id,
-		wpp::node_t expr,
-		wpp::Env& env,
-		wpp::FnEnv* fn_env
+		const wpp::Str& msg,
+		wpp::Env& env
 	) {
 		DBG();
-
-		const auto msg = evaluate(expr, env, fn_env);
-		wpp::error(report_modes::semantic, node_id, env, "user error", msg);
-
-		return "";
+		wpp::error(report_modes::semantic, node_id, env, "user error", msg.str());
 	}
 
 
-	std::string intrinsic_log(
+	void intrinsic_log(
 		wpp::node_t node_id,
-		wpp::node_t expr,
-		wpp::Env& env,
-		wpp::FnEnv* fn_env
+		const wpp::Str& msg,
+		wpp::Env& env
 	) {
 		DBG();
-		std::cerr << evaluate(expr, env, fn_env);
-		return "";
+		std::cerr << msg;
 	}
 }
 
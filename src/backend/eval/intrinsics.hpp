@@ -5,18 +5,31 @@
 
 #include <string>
 #include <vector>
+#include <filesystem>
 
+#include <structures/str.hpp>
 #include <structures/environment.hpp>
+#include <misc/report.hpp>
 
 namespace wpp {
-	std::string intrinsic_log    (wpp::node_t, wpp::node_t, wpp::Env&,              wpp::FnEnv* = nullptr);
-	std::string intrinsic_error  (wpp::node_t, wpp::node_t, wpp::Env&,              wpp::FnEnv* = nullptr);
-	std::string intrinsic_assert (wpp::node_t, wpp::node_t, wpp::node_t, wpp::Env&, wpp::FnEnv* = nullptr);
-	std::string intrinsic_file   (wpp::node_t, wpp::node_t, wpp::Env&,              wpp::FnEnv* = nullptr);
-	std::string intrinsic_use    (wpp::node_t, wpp::node_t, wpp::Env&,              wpp::FnEnv* = nullptr);
-	std::string intrinsic_eval   (wpp::node_t, wpp::node_t, wpp::Env&,              wpp::FnEnv* = nullptr);
-	std::string intrinsic_run    (wpp::node_t, wpp::node_t, wpp::Env&,              wpp::FnEnv* = nullptr);
-	std::string intrinsic_pipe   (wpp::node_t, wpp::node_t, wpp::node_t, wpp::Env&, wpp::FnEnv* = nullptr);
+	// Intrinsics operate on already evaluated operands so they can be shared
+	// by the tree walking evaluator and the bytecode vm.
+	void        intrinsic_log    (wpp::node_t, const wpp::Str&, wpp::Env&);
+	void        intrinsic_error  (wpp::node_t, const wpp::Str&, wpp::Env&);
+	void        intrinsic_assert (wpp::node_t, const wpp::Str&, const wpp::Str&, wpp::Env&);
+	wpp::Str    intrinsic_file   (wpp::node_t, const wpp::Str&, wpp::Env&);
+	std::string intrinsic_run    (wpp::node_t, const wpp::Str&, wpp::Env&);
+	std::string intrinsic_pipe   (wpp::node_t, const wpp::Str&, const wpp::Str&, wpp::Env&);
+
+	// `use` and `!` push a new source and return the root of its tree, it is up to
+	// the caller to evaluate it.
+	// `use` returns NODE_EMPTY if the file has already been sourced. The caller is
+	// expected to restore the working directory to `old_path` afterwards.
+	wpp::node_t intrinsic_use  (wpp::node_t, const wpp::Str&, wpp::Env&, std::filesystem::path&);
+	wpp::node_t intrinsic_eval (wpp::node_t, const wpp::Str&, wpp::Env&);
+
+	// Re-report an error raised inside of `!` at the location of the `!` itself.
+	[[noreturn]] void intrinsic_eval_error(wpp::node_t, const wpp::Report&, wpp::Env&);
 }
 
 #endif
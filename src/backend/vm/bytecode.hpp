@@ -0,0 +1,96 @@
+#pragma once
+
+#ifndef WOTPP_BYTECODE
+#define WOTPP_BYTECODE
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+#include <cstdint>
+
+#include <misc/fwddecl.hpp>
+#include <frontend/ast.hpp>
+
+
+namespace wpp {
+	using opcode_t = uint8_t;
+
+	// Every instruction leaves exactly one string on the value stack for every
+	// expression it completes so that the result of a chunk is whatever is left
+	// on top when we reach `ret`.
+	namespace opcodes {
+		#define OPCODES \
+			OP(push_str)    /* Push the value of the `String` node. */ \
+			OP(varref)      /* Push the value of a variable or parameter. */ \
+			OP(cat)         /* Concatenate the top `arg` values. */ \
+			OP(discard)     /* Drop the top value. */ \
+			OP(output)      /* Pop the top value and write it to the output. */ \
+			\
+			OP(call)        /* Call a function with `arg` arguments. */ \
+			OP(call_pop)    /* Call a function with `arg` arguments and pop the rest from the stack. */ \
+			OP(ret)         /* Return from the current frame. */ \
+			\
+			OP(define_fn) \
+			OP(define_var) \
+			OP(drop) \
+			\
+			OP(new_stack) \
+			OP(end_stack) \
+			OP(slice) \
+			\
+			OP(jump)        /* Unconditional jump to `arg`. */ \
+			OP(match_cmp)   /* Compare arm with test, jump to `arg` on success. */ \
+			OP(match_table) /* Lookup test in jump table `arg`. */ \
+			OP(no_match) \
+			\
+			OP(eval) \
+			OP(use) \
+			OP(file) \
+			OP(run) \
+			OP(pipe) \
+			OP(assert) \
+			OP(error) \
+			OP(log)
+
+		#define OP(x) x,
+			enum: opcode_t { OPCODES };
+		#undef OP
+
+		#define OP(x) #x,
+			constexpr const char* op_to_str[] = { OPCODES };
+		#undef OP
+
+		#undef OPCODES
+	}
+
+
+	struct Instr {
+		wpp::opcode_t op{};
+		int32_t arg{};
+		wpp::node_t node = wpp::NODE_EMPTY;   // Node used for lookups and error reporting.
+	};
+
+
+	// Used by `match` when every arm is a string literal. The keys are views
+	// of `keys` so that looking up a value doesn't have to copy it, moving
+	// the table leaves them where they are.
+	struct JumpTable {
+		std::unordered_map<std::string_view, int32_t> targets{};
+		std::unique_ptr<char[]> keys{};
+		size_t longest{};   // Longer strings can't match so we skip the lookup.
+		int32_t otherwise{};
+	};
+
+
+	// A linear sequence of instructions compiled from a single tree, either
+	// the root of a document or the body of a function.
+	struct Chunk {
+		std::vector<wpp::Instr> code{};
+		std::vector<wpp::JumpTable> tables{};
+	};
+}
+
+#endif
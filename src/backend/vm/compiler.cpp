@@ -0,0 +1,238 @@
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+#include <misc/util/util.hpp>
+#include <structures/environment.hpp>
+#include <frontend/parser/ast_nodes.hpp>
+#include <backend/vm/bytecode.hpp>
+#include <backend/vm/compiler.hpp>
+
+
+namespace wpp { namespace {
+	struct Compiler {
+		const wpp::Env& env;
+		wpp::Chunk& chunk;
+		const bool top;   // Compiling the program itself, see `compile`.
+
+
+		int32_t emit(wpp::opcode_t op, int32_t arg = 0, wpp::node_t node = wpp::NODE_EMPTY) {
+			chunk.code.push_back(wpp::Instr{op, arg, node});
+			return static_cast<int32_t>(chunk.code.size() - 1);
+		}
+
+		int32_t here() const {
+			return static_cast<int32_t>(chunk.code.size());
+		}
+
+		void patch(int32_t instr, int32_t target) {
+			chunk.code[instr].arg = target;
+		}
+
+
+		// Collect the operands of a chain of concatenations so that the whole
+		// chain becomes a single `cat`.
+		void flatten_cat(wpp::node_t node_id, std::vector<wpp::node_t>& leaves) {
+			if (const auto* cat = std::get_if<Concat>(&env.ast[node_id])) {
+				flatten_cat(cat->lhs, leaves);
+				flatten_cat(cat->rhs, leaves);
+			}
+
+			else
+				leaves.emplace_back(node_id);
+		}
+
+
+		void compile_match(wpp::node_t node_id, const Match& match) {
+			DBG();
+
+			const auto cases = env.ast.list(match.cases);
+			const size_t n_cases = cases.size() / 2;
+
+			compile(match.expr);
+
+			// If every arm is a literal, we can jump straight to the hand instead
+			// of comparing against each arm in turn.
+			bool all_literals = true;
+
+			for (size_t i = 0; i != n_cases; ++i)
+				all_literals = all_literals and std::holds_alternative<String>(env.ast[cases[i * 2]]);
+
+			std::vector<int32_t> arm_jumps;
+			int32_t table = -1;
+
+			size_t key_offset = 0;
+
+			if (all_literals) {
+				table = static_cast<int32_t>(chunk.tables.size());
+				chunk.tables.emplace_back();
+				emit(opcodes::match_table, table, node_id);
+
+				size_t key_bytes = 0;
+
+				for (size_t i = 0; i != n_cases; ++i)
+					key_bytes += env.ast.string(env.ast.get<String>(cases[i * 2])).size();
+
+				chunk.tables[table].keys = std::make_unique<char[]>(key_bytes);
+			}
+
+			else {
+				for (size_t i = 0; i != n_cases; ++i) {
+					compile(cases[i * 2]);
+					arm_jumps.emplace_back(emit(opcodes::match_cmp, 0, node_id));
+				}
+
+				emit(opcodes::discard); // Test string.
+			}
+
+
+			// Fallthrough to the default arm.
+			if (table != -1)
+				chunk.tables[table].otherwise = here();
+
+			std::vector<int32_t> end_jumps;
+
+			if (match.default_case == wpp::NODE_EMPTY)
+				emit(opcodes::no_match, 0, node_id);
+
+			else {
+				compile(match.default_case);
+				end_jumps.emplace_back(emit(opcodes::jump));
+			}
+
+
+			// Hands.
+			for (size_t i = 0; i != n_cases; ++i) {
+				const wpp::node_t arm = cases[i * 2];
+				const wpp::node_t hand = cases[i * 2 + 1];
+
+				if (table != -1) {
+					auto& jump_table = chunk.tables[table];
+					const auto& str = env.ast.string(env.ast.get<String>(arm));
+
+					char* const key = jump_table.keys.get() + key_offset;
+					std::copy(str.begin(), str.end(), key);
+					key_offset += str.size();
+
+					jump_table.targets.emplace(std::string_view{ key, str.size() }, here()); // First arm wins.
+					jump_table.longest = std::max(jump_table.longest, str.size());
+				}
+
+				else
+					patch(arm_jumps[i], here());
+
+				compile(hand);
+				end_jumps.emplace_back(emit(opcodes::jump));
+			}
+
+			for (const int32_t jump: end_jumps)
+				patch(jump, here());
+		}
+
+
+		void compile(wpp::node_t node_id) {
+			wpp::visit(env.ast[node_id],
+				[&] (const IntrinsicRun& x)    { compile(x.expr); emit(opcodes::run, 0, node_id); },
+				[&] (const IntrinsicError& x)  { compile(x.expr); emit(opcodes::error, 0, node_id); },
+				[&] (const IntrinsicLog& x)    { compile(x.expr); emit(opcodes::log, 0, node_id); },
+				[&] (const IntrinsicFile& x)   { compile(x.expr); emit(opcodes::file, 0, node_id); },
+				[&] (const IntrinsicUse& x)    { compile(x.expr); emit(opcodes::use, 0, node_id); },
+				[&] (const IntrinsicPipe& x)   { compile(x.cmd); compile(x.value); emit(opcodes::pipe, 0, node_id); },
+				[&] (const IntrinsicAssert& x) { compile(x.lhs); compile(x.rhs); emit(opcodes::assert, 0, node_id); },
+
+				[&] (const FnInvoke& x) {
+					// Arguments are evaluated right to left.
+					const auto args = env.ast.list(x.arguments);
+
+					for (size_t i = args.size(); i > 0; --i)
+						compile(args[i - 1]);
+
+					emit(opcodes::call, args.size(), node_id);
+				},
+
+				[&] (const Pop& x) {
+					for (const wpp::node_t arg: env.ast.list(x.arguments))
+						compile(arg);
+
+					emit(opcodes::call_pop, x.arguments.size, node_id);
+				},
+
+				[&] (const Fn&)      { emit(opcodes::define_fn, 0, node_id); },
+				[&] (const Drop&)    { emit(opcodes::drop, 0, node_id); },
+				[&] (const Var& x)   { compile(x.body); emit(opcodes::define_var, 0, node_id); },
+				[&] (const VarRef&)  { emit(opcodes::varref, 0, node_id); },
+				[&] (const String&)  { emit(opcodes::push_str, 0, node_id); },
+				[&] (const Codeify& x) { compile(x.expr); emit(opcodes::eval, 0, node_id); },
+				[&] (const Slice& x) { compile(x.expr); emit(opcodes::slice, 0, node_id); },
+
+				[&] (const New& x) {
+					emit(opcodes::new_stack);
+					compile(x.expr);
+					emit(opcodes::end_stack);
+				},
+
+				[&] (const Concat&) {
+					std::vector<wpp::node_t> leaves;
+					flatten_cat(node_id, leaves);
+
+					for (const wpp::node_t leaf: leaves)
+						compile(leaf);
+
+					emit(opcodes::cat, leaves.size());
+				},
+
+				[&] (const Block& x) {
+					for (const wpp::node_t stmt: env.ast.list(x.statements)) {
+						compile(stmt);
+						emit(opcodes::discard);
+					}
+
+					compile(x.expr);
+				},
+
+				[&] (const Match& x) { compile_match(node_id, x); },
+
+				[&] (const Document& x) {
+					if (top) {
+						// Write each statement, and each operand of a
+						// concatenation, as soon as it is done rather than
+						// concatenating everything first.
+						for (const wpp::node_t stmt: env.ast.list(x.statements)) {
+							std::vector<wpp::node_t> leaves;
+							flatten_cat(stmt, leaves);
+
+							for (const wpp::node_t leaf: leaves) {
+								compile(leaf);
+								emit(opcodes::output);
+							}
+						}
+
+						emit(opcodes::cat, 0);
+						return;
+					}
+
+					for (const wpp::node_t stmt: env.ast.list(x.statements))
+						compile(stmt);
+
+					emit(opcodes::cat, x.statements.size);
+				}
+			);
+		}
+	};
+}}
+
+
+namespace wpp {
+	wpp::Chunk compile(const wpp::node_t node_id, const wpp::Env& env, const bool top) {
+		DBG();
+
+		wpp::Chunk chunk;
+		Compiler compiler{env, chunk, top};
+
+		compiler.compile(node_id);
+		compiler.emit(opcodes::ret);
+
+		return chunk;
+	}
+}
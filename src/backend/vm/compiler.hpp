@@ -0,0 +1,16 @@
+#pragma once
+
+#ifndef WOTPP_COMPILER
+#define WOTPP_COMPILER
+
+#include <structures/environment.hpp>
+#include <backend/vm/bytecode.hpp>
+
+namespace wpp {
+	// Lower the tree rooted at a node into a chunk ending with `ret`.
+	// The chunk for the program itself (`top`) writes its statements to
+	// the output as it goes and returns an empty string.
+	wpp::Chunk compile(const wpp::node_t, const wpp::Env&, const bool top = false);
+}
+
+#endif
@@ -0,0 +1,500 @@
+#include <string>
+#include <vector>
+#include <iterator>
+#include <filesystem>
+#include <unordered_map>
+
+#include <misc/util/util.hpp>
+#include <misc/flags.hpp>
+#include <misc/report.hpp>
+#include <structures/environment.hpp>
+#include <frontend/parser/ast_nodes.hpp>
+#include <backend/eval/eval.hpp>
+#include <backend/eval/intrinsics.hpp>
+#include <backend/vm/bytecode.hpp>
+#include <backend/vm/compiler.hpp>
+#include <backend/vm/vm.hpp>
+
+
+namespace wpp { namespace {
+	namespace frame_kinds {
+		enum: uint8_t {
+			top,
+			function,
+			eval,
+			use,
+		};
+	}
+
+
+	// Frames live on the heap so that the depth of a program is no longer
+	// bounded by the native stack.
+	struct Frame {
+		const wpp::Chunk* chunk = nullptr;
+		size_t pc = 0;
+
+		uint8_t kind{};
+		wpp::node_t node = wpp::NODE_EMPTY;   // Call site, `!` or `use` node that created this frame.
+		wpp::node_t root = wpp::NODE_EMPTY;   // Tree the chunk was compiled from.
+
+		wpp::FnEnv fn_env{};   // Shared with the caller for `!` and `use`.
+
+		std::filesystem::path old_path{};   // Only set for `use` frames.
+
+		wpp::MemoFrame memo{};   // Only set for `function` frames.
+
+		// Output of callers this frame replaced through a tail call in a
+		// concatenation, it goes in front of the result, see `call`.
+		std::string prefix{};
+	};
+
+
+	struct VM {
+		wpp::Env& env;
+
+		std::unordered_map<wpp::node_t, wpp::Chunk> chunks{};   // Compiled lazily, keyed by root node.
+
+		std::vector<wpp::Str> values{};
+		std::vector<Frame> frames{};
+
+
+		const wpp::Chunk& chunk_for(wpp::node_t root, bool top = false) {
+			if (auto it = chunks.find(root); it != chunks.end())
+				return it->second;
+
+			return chunks.emplace(root, wpp::compile(root, env, top)).first->second;
+		}
+
+
+		void enter(
+			wpp::node_t root,
+			uint8_t kind,
+			wpp::node_t node_id,
+			const wpp::FnEnv& fn_env,
+			std::filesystem::path&& old_path = {}
+		) {
+			const size_t used =
+				frames.size() * sizeof(Frame) +
+				values.size() * sizeof(wpp::Str) +
+				env.arguments.size() * sizeof(wpp::Str);
+
+			// Memoized results share the budget but give way to the stacks.
+			if (used + env.memo_bytes > env.memory_budget)
+				wpp::memo_clear(env);
+
+			if (used > env.memory_budget)
+				wpp::error(report_modes::semantic, node_id, env, "stack exhausted",
+					wpp::cat("evaluation used more than ", env.memory_budget, " bytes of stack"),
+					"this may indicate recursion without an exit condition, otherwise raise --memory-budget"
+				);
+
+			frames.push_back(Frame{ &chunk_for(root, kind == frame_kinds::top), 0, kind, node_id, root, fn_env, std::move(old_path) });
+		}
+
+
+		wpp::Str pop() {
+			wpp::Str str = std::move(values.back());
+			values.pop_back();
+			return str;
+		}
+
+
+
+		// Chunks compiled from reclaimed nodes must not be found by the nodes
+		// which replace them.
+		void reclaim() {
+			DBG();
+
+			if (not wpp::reclaim_regions(env))
+				return;
+
+			for (auto it = chunks.begin(); it != chunks.end();) {
+				if (static_cast<size_t>(it->first) >= env.ast.size())
+					it = chunks.erase(it);
+
+				else
+					++it;
+			}
+		}
+
+
+		size_t skip_jumps(const wpp::Chunk& chunk, size_t pc) const {
+			while (chunk.code[pc].op == opcodes::jump)
+				pc = chunk.code[pc].arg;
+
+			return pc;
+		}
+
+		// Check if the frame has nothing left to do but return, following any
+		// jumps out of a match. A call that is the last operand of a `cat`
+		// which is then returned is also in tail position, `leading` is set
+		// to the number of operands in front of it.
+		bool in_tail_position(const Frame& frame, size_t& leading) const {
+			const auto& code = frame.chunk->code;
+			const size_t pc = skip_jumps(*frame.chunk, frame.pc);
+
+			leading = 0;
+
+			if (code[pc].op == opcodes::cat and code[skip_jumps(*frame.chunk, pc + 1)].op == opcodes::ret) {
+				leading = code[pc].arg - 1;
+				return true;
+			}
+
+			return code[pc].op == opcodes::ret;
+		}
+
+
+		// The arguments are the values above `base`.
+		void call(wpp::node_t node_id, const wpp::symbol_t symbol, size_t base) {
+			DBG();
+
+			const size_t n_args = values.size() - base;
+
+			// A call in tail position replaces the frame of its caller so that
+			// recursion in tail position runs in constant space. The callee
+			// returns straight to the frame below. Operands of a `cat` in front
+			// of the call are moved to the prefix of the callee, which also
+			// takes over the prefix of the caller.
+			std::string prefix;
+			size_t leading = 0;
+
+			if (Frame& caller = frames.back(); caller.kind == frame_kinds::function and in_tail_position(caller, leading)) {
+				prefix = std::move(caller.prefix);
+
+				for (size_t i = base - leading; i != base; ++i)
+					prefix += values[i];
+
+				values.erase(values.begin() + (base - leading), values.begin() + base);
+				base -= leading;
+
+				caller.memo.active = false;
+				wpp::memo_end(caller.fn_env, wpp::Str{}, env, caller.memo);
+				wpp::finish_call(caller.fn_env, env);
+
+				frames.pop_back();
+			}
+
+			wpp::FnEnv fn_env;
+			const wpp::node_t body = wpp::setup_call(node_id, symbol, values, base, env, fn_env);
+
+			wpp::MemoFrame memo;
+
+			if (const wpp::Str* result = wpp::memo_begin(fn_env, n_args, env, memo)) {
+				if (prefix.empty())
+					values.emplace_back(*result);
+
+				else {
+					prefix += *result;
+					values.emplace_back(std::move(prefix));
+				}
+
+				wpp::finish_call(fn_env, env);
+				return;
+			}
+
+			try {
+				enter(body, frame_kinds::function, node_id, fn_env);
+			}
+
+			catch (const wpp::Report&) {
+				memo.active = false;
+				wpp::memo_end(fn_env, wpp::Str{}, env, memo);
+				wpp::finish_call(fn_env, env);
+
+				throw;
+			}
+
+			frames.back().memo = memo;
+			frames.back().prefix = std::move(prefix);
+		}
+
+
+		// Errors raised inside of `use` or `!` are propagated the same way the
+		// tree walker does it: `use` marks the error as coming from another
+		// source and `!` re-reports the error at its own location.
+		//
+		// The repl keeps using the environment after an error so every frame
+		// gives back what it took from it, the same as `ret` does.
+		[[noreturn]] void unwind(wpp::Report report) {
+			DBG();
+
+			for (; not frames.empty(); frames.pop_back()) {
+				Frame& frame = frames.back();
+
+				if (frame.kind == frame_kinds::function) {
+					frame.memo.active = false;
+					wpp::memo_end(frame.fn_env, wpp::Str{}, env, frame.memo);
+					wpp::finish_call(frame.fn_env, env);
+				}
+
+				else if (frame.kind == frame_kinds::use)
+					env.state |=
+						wpp::ABORT_EVALUATION |
+						wpp::ERROR_MODE_EVAL;
+
+				else if (frame.kind == frame_kinds::eval) {
+					wpp::release_region(frame.root, env);
+
+					try {
+						wpp::intrinsic_eval_error(frame.node, report, env);
+					}
+
+					catch (const wpp::Report& e) {
+						report = e;
+					}
+				}
+			}
+
+			throw report;
+		}
+
+
+		void run(std::string& out) {
+			DBG();
+
+			while (true) {
+				Frame& frame = frames.back();
+				const wpp::Instr& instr = frame.chunk->code[frame.pc++];
+
+				const wpp::node_t node_id = instr.node;
+
+				switch (instr.op) {
+					case opcodes::push_str:
+						values.emplace_back(env.ast.string(env.ast.get<String>(node_id)));
+						break;
+
+					case opcodes::varref:
+						values.emplace_back(wpp::lookup_var(node_id, env.ast.get<VarRef>(node_id), env,
+							frame.fn_env.func == wpp::NODE_EMPTY ? nullptr : &frame.fn_env
+						));
+						break;
+
+					case opcodes::cat: {
+						if (instr.arg == 0) {
+							values.emplace_back();
+							break;
+						}
+
+						const auto first = values.end() - instr.arg;
+
+						size_t length = 0;
+						for (auto it = first; it != values.end(); ++it)
+							length += it->size();
+
+						// Reuse the buffer of the first operand if nothing else shares it.
+						std::string str = std::move(*first).str();
+						str.reserve(length);
+
+						for (auto it = first + 1; it != values.end(); ++it)
+							str += *it;
+
+						*first = wpp::Str{std::move(str)};
+						values.erase(first + 1, values.end());
+					} break;
+
+					case opcodes::discard:
+						values.pop_back();
+						break;
+
+					case opcodes::output:
+						wpp::output(out, values.back(), env);
+						values.pop_back();
+						break;
+
+
+					case opcodes::call:
+						call(node_id, env.ast.get<FnInvoke>(node_id).symbol, values.size() - instr.arg);
+						break;
+
+					case opcodes::call_pop: {
+						const auto& pop = env.ast.get<Pop>(node_id);
+						const size_t base = values.size() - instr.arg;
+
+						wpp::collect_popped_args(pop, values, base, env);
+						call(node_id, pop.symbol, base);
+					} break;
+
+					case opcodes::ret: {
+						wpp::Str result = pop();
+
+						if (frame.kind == frame_kinds::function) {
+							wpp::memo_end(frame.fn_env, result, env, frame.memo);
+							wpp::finish_call(frame.fn_env, env);
+						}
+
+						else if (frame.kind == frame_kinds::use)
+							std::filesystem::current_path(frame.old_path);
+
+						if (not frame.prefix.empty()) {
+							frame.prefix += result;
+							result = wpp::Str{std::move(frame.prefix)};
+						}
+
+						const bool was_eval = frame.kind == frame_kinds::eval;
+
+						if (was_eval)
+							wpp::release_region(frame.root, env);
+
+						frames.pop_back();
+
+						if (was_eval)
+							reclaim();
+
+						if (frames.empty()) {
+							out += result;
+							return;
+						}
+
+						values.emplace_back(std::move(result));
+					} break;
+
+
+					case opcodes::define_fn:
+						wpp::define_func(node_id, env.ast.get<Fn>(node_id), env);
+						values.emplace_back();
+						break;
+
+					case opcodes::define_var:
+						wpp::define_var(node_id, env.ast.get<Var>(node_id), pop(), env);
+						values.emplace_back();
+						break;
+
+					case opcodes::drop:
+						wpp::drop_func(node_id, env.ast.get<Drop>(node_id), env);
+						reclaim();
+						values.emplace_back();
+						break;
+
+
+					case opcodes::new_stack:
+						env.stack.emplace_back();
+						break;
+
+					case opcodes::end_stack:
+						env.stack.pop_back();
+						break;
+
+					case opcodes::slice: {
+						const wpp::Str str = pop();
+						values.emplace_back(wpp::slice_string(env.ast.get<Slice>(node_id), str, env));
+					} break;
+
+
+					case opcodes::jump:
+						frame.pc = instr.arg;
+						break;
+
+					case opcodes::match_cmp: {
+						const wpp::Str arm = pop();
+
+						if (values.back() == arm) {
+							values.pop_back();
+							frame.pc = instr.arg;
+						}
+					} break;
+
+					case opcodes::match_table: {
+						const wpp::Str test = pop();
+						const auto& table = frame.chunk->tables[instr.arg];
+
+						if (test.size() > table.longest)
+							frame.pc = table.otherwise;
+
+						else if (auto it = table.targets.find(test.view()); it != table.targets.end())
+							frame.pc = it->second;
+
+						else
+							frame.pc = table.otherwise;
+					} break;
+
+					case opcodes::no_match:
+						wpp::error(report_modes::semantic, node_id, env, "no matches found",
+							"exhausted all checks in match expression"
+						);
+
+
+					case opcodes::eval: {
+						const wpp::Str source = pop();
+						const wpp::FnEnv fn_env = frame.fn_env;
+
+						wpp::node_t root = wpp::NODE_EMPTY;
+
+						try {
+							root = wpp::intrinsic_eval(node_id, source, env);
+						}
+
+						catch (const wpp::Report& e) {
+							wpp::intrinsic_eval_error(node_id, e, env);
+						}
+
+						enter(root, frame_kinds::eval, node_id, fn_env);
+						wpp::retain_region(root, env);
+					} break;
+
+					case opcodes::use: {
+						std::filesystem::path old_path;
+						const wpp::FnEnv fn_env = frame.fn_env;
+
+						const wpp::node_t root = wpp::intrinsic_use(node_id, pop(), env, old_path);
+
+						if (root == wpp::NODE_EMPTY)
+							values.emplace_back();
+
+						else
+							enter(root, frame_kinds::use, node_id, fn_env, std::move(old_path));
+					} break;
+
+					case opcodes::file:
+						values.emplace_back(wpp::intrinsic_file(node_id, pop(), env));
+						break;
+
+					case opcodes::run:
+						values.emplace_back(wpp::intrinsic_run(node_id, pop(), env));
+						break;
+
+					case opcodes::pipe: {
+						const wpp::Str data = pop();
+						const wpp::Str cmd = pop();
+
+						values.emplace_back(wpp::intrinsic_pipe(node_id, cmd, data, env));
+					} break;
+
+					case opcodes::assert: {
+						const wpp::Str rhs = pop();
+						const wpp::Str lhs = pop();
+
+						wpp::intrinsic_assert(node_id, lhs, rhs, env);
+						values.emplace_back();
+					} break;
+
+					case opcodes::error:
+						wpp::intrinsic_error(node_id, pop(), env);
+						break;
+
+					case opcodes::log:
+						wpp::intrinsic_log(node_id, pop(), env);
+						values.emplace_back();
+						break;
+				}
+			}
+		}
+	};
+}}
+
+
+namespace wpp {
+	void execute(const wpp::node_t root, wpp::Env& env, std::string& out) {
+		DBG();
+
+		VM vm{env};
+		vm.enter(root, frame_kinds::top, root, wpp::FnEnv{});
+
+		try {
+			vm.run(out);
+		}
+
+		catch (const wpp::Report& e) {
+			vm.unwind(e);
+		}
+	}
+}
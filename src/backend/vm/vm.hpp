@@ -0,0 +1,16 @@
+#pragma once
+
+#ifndef WOTPP_VM
+#define WOTPP_VM
+
+#include <string>
+
+#include <structures/environment.hpp>
+
+namespace wpp {
+	// Compile a tree to bytecode and run it, appending the output to a caller
+	// provided sink. Produces the same output and reports as `wpp::evaluate`.
+	void execute(const wpp::node_t, wpp::Env&, std::string&);
+}
+
+#endif
@@ -4,8 +4,12 @@
 #define WOTPP_AST
 
 #include <vector>
+#include <memory_resource>
 #include <variant>
 #include <utility>
+#include <iterator>
+#include <cstddef>
+#include <cstdint>
 
 #include <misc/fwddecl.hpp>
 #include <misc/dbg.hpp>
@@ -16,11 +20,95 @@ namespace wpp {
 	constexpr node_t NODE_EMPTY = -1;
 	constexpr node_t NODE_ROOT = 0;
 
+	// A range of entries in a shared pool of indices. Nodes which have a
+	// variable number of children store them as a `List` instead of owning
+	// a vector each so that every node has the same small fixed size.
+	template <typename T>
+	struct List {
+		uint32_t begin{};
+		uint32_t size{};
+	};
+
+
+	// Iterates over a `List` by index so that it stays valid while the pool
+	// grows, which happens when `!` parses new code during evaluation.
+	template <typename T>
+	class ListView {
+		const std::pmr::vector<uint32_t>* pool = nullptr;
+		uint32_t first{};
+		uint32_t length{};
+
+		public:
+			class iterator {
+				const std::pmr::vector<uint32_t>* pool = nullptr;
+				uint32_t i{};
+
+				public:
+					using iterator_category = std::forward_iterator_tag;
+					using value_type = T;
+					using difference_type = std::ptrdiff_t;
+					using pointer = void;
+					using reference = T;
+
+					iterator(const std::pmr::vector<uint32_t>* pool_, uint32_t i_): pool(pool_), i(i_) {}
+
+					T operator*() const { return static_cast<T>((*pool)[i]); }
+					iterator& operator++() { ++i; return *this; }
+					iterator operator++(int) { iterator it = *this; ++i; return it; }
+
+					bool operator==(const iterator& other) const { return i == other.i; }
+					bool operator!=(const iterator& other) const { return i != other.i; }
+			};
+
+
+			ListView(const std::pmr::vector<uint32_t>& pool_, const List<T>& list):
+				pool(&pool_), first(list.begin), length(list.size) {}
+
+			iterator begin() const { return { pool, first }; }
+			iterator end() const { return { pool, first + length }; }
+
+			T operator[](size_t i) const { return static_cast<T>((*pool)[first + i]); }
+			T back() const { return (*this)[length - 1]; }
+
+			size_t size() const { return length; }
+			bool empty() const { return length == 0; }
+	};
+
+
 	template <typename... Ts>
-	class HeterogenousVector: public std::vector<std::variant<Ts...>> {
-		using std::vector<std::variant<Ts...>>::vector;
+	class HeterogenousVector: public std::pmr::vector<std::variant<Ts...>> {
+		using std::pmr::vector<std::variant<Ts...>>::vector;
 
 		public:
+			std::pmr::vector<uint32_t> pool{};   // Children of every node, see `List`.
+
+
+			HeterogenousVector() {}
+
+			explicit HeterogenousVector(std::pmr::memory_resource* resource):
+				std::pmr::vector<std::variant<Ts...>>(resource),
+				pool(resource) {}
+
+
+			// Append a list to the pool. Lists are built up separately and
+			// committed once complete because parsing the children of a node
+			// appends the lists of those children first.
+			template <typename T>
+			List<T> add_list(const std::vector<T>& elems) {
+				DBG();
+				const auto begin = static_cast<uint32_t>(pool.size());
+
+				for (const T& elem: elems)
+					pool.emplace_back(static_cast<uint32_t>(elem));
+
+				return { begin, static_cast<uint32_t>(elems.size()) };
+			}
+
+			template <typename T>
+			ListView<T> list(const List<T>& l) const {
+				return { pool, l };
+			}
+
 			// Construct element in place and return its index.
 			template <typename T, typename... Xs>
 			node_t add(Xs&&... args) {
@@ -4,6 +4,7 @@
 #define WOTPP_CHAR
 
 #include <algorithm>
+#include <array>
 #include <cstdint>
 
 #include <misc/utf8.hpp>
@@ -56,32 +57,63 @@ namespace wpp {
 		return *c >= lower and *c <= upper;
 	}
 
-	constexpr bool is_digit(const char* c) {
-		return in_range(c, '0', '9');
-	}
 
-	constexpr bool is_lower(const char* c) {
-		return in_range(c, 'a', 'z');
+	// Every byte is classified ahead of time so that checking a class is a
+	// single table lookup rather than a chain of comparisons.
+	namespace char_classes {
+		enum: uint16_t {
+			digit       = 1 << 0,
+			hex         = 1 << 1,
+			bin         = 1 << 2,
+			lower       = 1 << 3,
+			upper       = 1 << 4,
+			blank       = 1 << 5,    // ASCII whitespace.
+			grouping    = 1 << 6,
+			quote       = 1 << 7,
+			delimiter   = 1 << 8,    // Ends an identifier: ASCII whitespace, grouping, quotes, `,` and EOF.
+			string_end  = 1 << 9,    // Ends the text of a string: `\`, quotes and EOF.
+			smart       = 1 << 10,   // Prefix of a smart string.
+			space_lead  = 1 << 11,   // Lead byte of a multibyte whitespace character.
+		};
 	}
 
-	constexpr bool is_upper(const char* c) {
-		return in_range(c, 'A', 'Z');
-	}
+	namespace detail {
+		constexpr std::array<uint16_t, 256> make_char_classes() {
+			using namespace char_classes;
 
-	constexpr bool is_alpha(const char* c) {
-		return is_lower(c) or is_upper(c);
-	}
+			std::array<uint16_t, 256> table{};
 
-	constexpr bool is_alphanumeric(const char* c) {
-		return is_alpha(c) or is_digit(c);
-	}
+			for (int i = 0; i < 256; ++i) {
+				const char c = static_cast<char>(i);
+				uint16_t cls = 0;
 
-	constexpr bool is_grouping(const char* c) {
-		return in_group(c, '[', ']', '(', ')', '{', '}');
-	}
+				if (c >= '0' and c <= '9') cls |= digit | hex;
+				if (c >= 'a' and c <= 'z') cls |= lower;
+				if (c >= 'A' and c <= 'Z') cls |= upper;
+				if ((c >= 'a' and c <= 'f') or (c >= 'A' and c <= 'F')) cls |= hex;
+				if (c == '0' or c == '1') cls |= bin;
 
-	constexpr bool is_whitespace(const char* c) {
-		const auto is_whitespace_utf8 = [&c] () {
+				if (c == ' ' or (c >= '\t' and c <= '\r')) cls |= blank | delimiter;
+				if (c == '[' or c == ']' or c == '(' or c == ')' or c == '{' or c == '}') cls |= grouping | delimiter;
+				if (c == '"' or c == '\'') cls |= quote | delimiter | string_end;
+				if (c == ',' or c == '\0') cls |= delimiter;
+				if (c == '\\' or c == '\0') cls |= string_end;
+				if (c == 'p' or c == 'r' or c == 'c') cls |= smart;
+
+				// U+0085 and U+00A0 start with 0xC2, U+1680 with 0xE1,
+				// U+2000 to U+205F with 0xE2 and U+3000 with 0xE3.
+				if (i == 0xC2 or i == 0xE1 or i == 0xE2 or i == 0xE3) cls |= space_lead;
+
+				table[i] = cls;
+			}
+
+			return table;
+		}
+
+		inline constexpr std::array<uint16_t, 256> char_classes = make_char_classes();
+
+
+		inline bool is_whitespace_utf8(const char* c) {
 			int32_t chr = utf8::decode(c);
 
 			return
@@ -95,21 +127,72 @@ namespace wpp {
 				chr == 0x205F or
 				chr == 0x3000
 			;
-		};
+		}
+	}
+
+	constexpr bool has_class(const char* c, uint16_t cls) {
+		return detail::char_classes[static_cast<uint8_t>(*c)] & cls;
+	}
+
+
+	constexpr bool is_digit(const char* c) {
+		return has_class(c, char_classes::digit);
+	}
+
+	constexpr bool is_lower(const char* c) {
+		return has_class(c, char_classes::lower);
+	}
+
+	constexpr bool is_upper(const char* c) {
+		return has_class(c, char_classes::upper);
+	}
+
+	constexpr bool is_alpha(const char* c) {
+		return has_class(c, char_classes::lower | char_classes::upper);
+	}
+
+	constexpr bool is_alphanumeric(const char* c) {
+		return has_class(c, char_classes::lower | char_classes::upper | char_classes::digit);
+	}
+
+	constexpr bool is_grouping(const char* c) {
+		return has_class(c, char_classes::grouping);
+	}
+
+	constexpr bool is_whitespace(const char* c) {
+		return
+			has_class(c, char_classes::blank) or
+			(has_class(c, char_classes::space_lead) and detail::is_whitespace_utf8(c))
+		;
+	}
+
+	// Whitespace, grouping, quotes, `,` or EOF.
+	constexpr bool is_delimiter(const char* c) {
+		return
+			has_class(c, char_classes::delimiter) or
+			(has_class(c, char_classes::space_lead) and detail::is_whitespace_utf8(c))
+		;
+	}
+
+	// `\`, quotes or EOF.
+	constexpr bool is_string_end(const char* c) {
+		return has_class(c, char_classes::string_end);
+	}
 
-		return *c == ' ' or in_range(c, '\t', '\r') or is_whitespace_utf8();
+	constexpr bool is_smart(const char* c) {
+		return has_class(c, char_classes::smart);
 	}
 
 	constexpr bool is_hex(const char* c) {
-		return in_range(c, 'A', 'F') or in_range(c, 'a', 'f') or is_digit(c);
+		return has_class(c, char_classes::hex);
 	}
 
 	constexpr bool is_bin(const char* c) {
-		return in_group(c, '0', '1');
+		return has_class(c, char_classes::bin);
 	}
 
 	constexpr bool is_quote(const char* c) {
-		return in_group(c, '"', '\'');
+		return has_class(c, char_classes::quote);
 	}
 
 	constexpr bool is_escape(const char* c) {
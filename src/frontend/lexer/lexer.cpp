@@ -1,7 +1,12 @@
+#include <array>
+#include <cstring>
+#include <string_view>
+
 #include <misc/util/util.hpp>
 #include <frontend/token.hpp>
 #include <frontend/char.hpp>
 #include <frontend/lexer/lexer.hpp>
+#include <frontend/lexer/scan.hpp>
 
 
 namespace wpp {
@@ -68,8 +73,7 @@ namespace wpp {
 					type = TOKEN_STRING;
 
 					// Consume all characters except quotes, escapes and EOF.
-					while (not wpp::in_group(ptr, '\\', '"', '\'', '\0'))
-						next();
+					ptr = wpp::scan_string(ptr);
 
 					// Set view length equal to the number of consumed characters.
 					vlen = ptr - vptr;
@@ -80,8 +84,7 @@ namespace wpp {
 				type = TOKEN_STRING;
 
 				// Consume all characters except quotes, escapes and EOF.
-				while (not wpp::in_group(ptr, '"', '\'', '\0'))
-					next();
+				ptr = wpp::scan_raw_string(ptr);
 
 				// Set view length equal to the number of consumed characters.
 				vlen = ptr - vptr;
@@ -115,9 +118,17 @@ namespace wpp {
 				else {
 					type = TOKEN_STRING;
 
-					// Consume all characters except quotes, escapes and EOF.
-					while (not (wpp::in_group(ptr, '\\', '"', '\'', '\0') or wpp::is_whitespace(ptr)))
+					// Consume all characters except quotes, escapes, whitespace and EOF.
+					// The scanner stops at every non-ASCII character so we
+					// check for multibyte whitespace here.
+					while (true) {
+						ptr = wpp::scan_text(ptr);
+
+						if (wpp::is_string_end(ptr) or wpp::is_whitespace(ptr))
+							break;
+
 						next();
+					}
 
 					// Set view length equal to the number of consumed characters.
 					vlen = ptr - vptr;
@@ -179,7 +190,7 @@ namespace wpp {
 			// and skip comment contents.
 			int depth = 1;
 
-			while (depth > 0 and *ptr != '\0') {
+			while (depth > 0 and *(ptr = wpp::scan_comment(ptr)) != '\0') {
 				if (*ptr == '#' and *(ptr + 1) == '[')
 					depth++, lex.next(2);
 
@@ -269,10 +280,12 @@ namespace wpp {
 
 			tok.type = TOKEN_WHITESPACE;
 
-			// Consume as much whitespace as we can.
-			do
+			// Consume as much whitespace as we can. Runs of ASCII whitespace
+			// are skipped in one go.
+			do {
 				lex.next();
-			while (wpp::is_whitespace(lex.ptr));
+				lex.ptr = wpp::skip_blanks(lex.ptr);
+			} while (wpp::is_whitespace(lex.ptr));
 
 			// Set token view length to the number of consumed characters.
 			tok.view.length = lex.ptr - tok.view.ptr;
@@ -311,13 +324,7 @@ namespace wpp {
 
 			do
 				lex.next();
-			while (
-				not wpp::is_whitespace(ptr) and
-				not wpp::is_quote(ptr) and
-				not wpp::is_grouping(ptr) and
-				*ptr != ',' and
-				*ptr != '\0'
-			);
+			while (not wpp::is_delimiter(ptr));
 
 			if (ptr == vptr)
 				wpp::error(report_modes::lexical, lex.position_from_view(view), lex.env, "empty stringify",
@@ -328,6 +335,105 @@ namespace wpp {
 		}
 
 
+		struct Keyword {
+			std::string_view name;
+			wpp::token_type_t type;
+		};
+
+		constexpr Keyword keywords[] = {
+			{ "let",    TOKEN_LET },
+			{ "match",  TOKEN_MATCH },
+			{ "pop",    TOKEN_POP },
+			{ "drop",   TOKEN_DROP },
+			{ "new",    TOKEN_NEW },
+
+			{ "use",    TOKEN_INTRINSIC_USE },
+			{ "run",    TOKEN_INTRINSIC_RUN },
+			{ "file",   TOKEN_INTRINSIC_FILE },
+			{ "assert", TOKEN_INTRINSIC_ASSERT },
+			{ "pipe",   TOKEN_INTRINSIC_PIPE },
+			{ "error",  TOKEN_INTRINSIC_ERROR },
+			{ "log",    TOKEN_INTRINSIC_LOG },
+		};
+
+
+		// Keywords are found with a perfect hash of their length and their
+		// first and last characters. The multiplier is searched for at
+		// compile time so that every keyword lands in its own slot.
+		constexpr uint32_t KEYWORD_SLOT_BITS = 5;
+
+		constexpr uint32_t keyword_slot(const char* ptr, uint32_t length, uint32_t seed) {
+			const uint32_t key =
+				static_cast<uint8_t>(ptr[0]) |
+				static_cast<uint8_t>(ptr[length - 1]) << 8 |
+				length << 16;
+
+			return (key * seed) >> (32 - KEYWORD_SLOT_BITS);
+		}
+
+		constexpr uint32_t find_keyword_seed() {
+			// Start from the golden ratio so that small keys reach the high bits.
+			for (uint32_t seed = 0x9E3779B1; seed != 0x9E3779B1 + (1 << 16); seed += 2) {
+				bool used[1 << KEYWORD_SLOT_BITS]{};
+				bool collision = false;
+
+				for (const auto& [name, type]: keywords) {
+					const uint32_t slot = keyword_slot(name.data(), name.size(), seed);
+
+					collision = collision or used[slot];
+					used[slot] = true;
+				}
+
+				if (not collision)
+					return seed;
+			}
+
+			return 0;
+		}
+
+		constexpr uint32_t KEYWORD_SEED = find_keyword_seed();
+		static_assert(KEYWORD_SEED != 0, "no perfect hash for keywords");
+
+		// Index of the keyword in each slot, plus one so that zero means empty.
+		constexpr auto keyword_slots = [] {
+			std::array<uint8_t, 1 << KEYWORD_SLOT_BITS> slots{};
+
+			for (size_t i = 0; i != std::size(keywords); ++i)
+				slots[keyword_slot(keywords[i].name.data(), keywords[i].name.size(), KEYWORD_SEED)] = i + 1;
+
+			return slots;
+		}();
+
+		constexpr auto keyword_lengths = [] {
+			std::pair<size_t, size_t> bounds{ keywords[0].name.size(), keywords[0].name.size() };
+
+			for (const auto& [name, type]: keywords) {
+				bounds.first = std::min(bounds.first, name.size());
+				bounds.second = std::max(bounds.second, name.size());
+			}
+
+			return bounds;
+		}();
+
+
+		wpp::token_type_t lookup_keyword(const wpp::View& view) {
+			if (view.length < keyword_lengths.first or view.length > keyword_lengths.second)
+				return TOKEN_IDENTIFIER;
+
+			const uint8_t index = keyword_slots[keyword_slot(view.ptr, view.length, KEYWORD_SEED)];
+
+			if (index == 0)
+				return TOKEN_IDENTIFIER;
+
+			const auto& [name, type] = keywords[index - 1];
+
+			if (name.size() == view.length and std::memcmp(name.data(), view.ptr, view.length) == 0)
+				return type;
+
+			return TOKEN_IDENTIFIER;
+		}
+
+
 		void lex_identifier(wpp::Lexer& lex, wpp::Token& tok) {
 			DBG();
 
@@ -341,31 +447,13 @@ namespace wpp {
 			// Make sure we don't run into a character that belongs to another token.
 			do
 				lex.next();
-			while (
-				not wpp::is_whitespace(ptr) and
-				not wpp::is_grouping(ptr) and
-				not wpp::is_quote(ptr) and
-				*ptr != ',' and
-				*ptr != '\0'
-			);
+			while (not wpp::is_delimiter(ptr));
 
 			// Set length to the number of consumed characters.
 			vlen = ptr - vptr;
 
 			// Check if consumed string is actually a keyword.
-			if      (view == "let")    type = TOKEN_LET;
-			else if (view == "match")  type = TOKEN_MATCH;
-			else if (view == "pop")    type = TOKEN_POP;
-			else if (view == "drop")   type = TOKEN_DROP;
-			else if (view == "new")    type = TOKEN_NEW;
-
-			else if (view == "use")    type = TOKEN_INTRINSIC_USE;
-			else if (view == "run")    type = TOKEN_INTRINSIC_RUN;
-			else if (view == "file")   type = TOKEN_INTRINSIC_FILE;
-			else if (view == "assert") type = TOKEN_INTRINSIC_ASSERT;
-			else if (view == "pipe")   type = TOKEN_INTRINSIC_PIPE;
-			else if (view == "error")  type = TOKEN_INTRINSIC_ERROR;
-			else if (view == "log")    type = TOKEN_INTRINSIC_LOG;
+			type = lookup_keyword(view);
 		}
 
 
@@ -436,7 +524,7 @@ namespace wpp {
 		void lex_mode_normal(wpp::Lexer& lex, wpp::Token& tok) {
 			DBG();
 
-			if (wpp::in_group(lex.ptr, 'p', 'r', 'c'))
+			if (wpp::is_smart(lex.ptr))
 				lex_smart(lex, tok);
 
 			else if (*lex.ptr == '\\')
@@ -105,8 +105,12 @@ namespace wpp {
 		wpp::Env& env;
 		const char* ptr = nullptr;
 
+		// The next token is only lexed once the parser asks for it so that
+		// it is lexed in the mode the parser wants. Until then `ptr` points
+		// to where it begins, afterwards to where it ends.
 		wpp::Token lookahead{};
 		wpp::lexer_mode_type_t lookahead_mode = lexer_modes::normal;
+		bool lexed = false;
 
 
 		Lexer(
@@ -118,7 +122,9 @@ namespace wpp {
 			lookahead({ptr, 1}, TOKEN_NONE),
 			lookahead_mode(mode_)
 		{
-			if (not utf8::validate(ptr)) {
+			if (not env.sources.top().validated and not utf8::validate(ptr)) {
+				env.utf8_taint = true;
+
 				wpp::error(report_modes::encoding, position_from_view(wpp::View{ ptr, 1 }), env,
 					"invalid UTF-8",
 					"malformed bytes appear in source"
@@ -131,14 +137,14 @@ namespace wpp {
 			}
 
 			ptr = env_.sources.top().base;
-
-			advance(mode_);
 		}
 
 
-		wpp::Pos position() const {
+		// Position of the next token, lexed in the mode of the last token if
+		// the parser hasn't asked for it yet.
+		wpp::Pos position() {
 			DBG();
-			return { &env.sources.top(), lookahead.view };
+			return { &env.sources.top(), peek(lookahead_mode).view };
 		}
 
 		wpp::Pos position_from_view(const wpp::View& v) const {
@@ -150,15 +156,31 @@ namespace wpp {
 		const wpp::Token& peek(wpp::lexer_mode_type_t mode = lexer_modes::normal) {
 			DBG();
 
+			if (not lexed) {
+				lookahead = next_token_wrapper(mode);
+				lookahead_mode = mode;
+				lexed = true;
+			}
+
 			// If the current mode is different from the lookahead mode
 			// then we update the lookahead token and set the new
-			// lookahead mode.
-			if (mode != lookahead_mode) {
+			// lookahead mode. Quotes and EOF come out the same in every mode
+			// except for `chr` so they can be kept as they are. This is
+			// what happens at both ends of every string.
+			else if (mode != lookahead_mode) {
 				DBG(detail::lookup_colour_enabled(ANSI_FG_RED), lexer_modes::lexer_mode_to_str[lookahead_mode], " -> ", lexer_modes::lexer_mode_to_str[mode]);
 
-				ptr = lookahead.view.ptr; // Reset pointer to beginning of lookahead token.
+				const bool same_in_any_mode =
+					lookahead.type == TOKEN_EOF or
+					(mode != lexer_modes::chr and (lookahead.type == TOKEN_QUOTE or lookahead.type == TOKEN_DOUBLEQUOTE));
+
+				if (not same_in_any_mode) {
+					ptr = lookahead.view.ptr; // Reset pointer to beginning of lookahead token.
+
+					env.stats.tokens_relexed++;
+					lookahead = next_token_wrapper(mode);
+				}
 
-				lookahead = next_token_wrapper(mode);
 				lookahead_mode = mode;
 			}
 
@@ -178,7 +200,7 @@ namespace wpp {
 			DBG();
 
 			auto tok = peek(mode);
-			lookahead = next_token_wrapper(mode);
+			lexed = false;
 			return tok;
 		}
 
@@ -186,6 +208,7 @@ namespace wpp {
 		// before propagating the error.
 		wpp::Token next_token_wrapper(wpp::lexer_mode_type_t mode = lexer_modes::normal) {
 			try {
+				env.stats.tokens_lexed++;
 				return next_token(mode);
 			}
 
@@ -0,0 +1,319 @@
+#include <cstdint>
+#include <cstddef>
+
+#include <frontend/lexer/scan.hpp>
+
+// SSE2 is part of x86-64 so it is always available there. AVX2 is picked at
+// runtime when the CPU supports it, everything else gets the scalar loops.
+#if defined(__SSE2__) or defined(_M_X64)
+	#define WPP_SCAN_SSE2
+	#include <emmintrin.h>
+#endif
+
+#if (defined(__GNUC__) or defined(__clang__)) and defined(__x86_64__)
+	#define WPP_SCAN_AVX2
+	#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER) and not defined(__clang__)
+	#include <intrin.h>
+#endif
+
+// Aligned loads may read bytes before the start of the buffer which is fine
+// for the hardware but not for the address sanitizer.
+#if defined(__GNUC__) or defined(__clang__)
+	#define WPP_NO_ASAN __attribute__((no_sanitize_address))
+#else
+	#define WPP_NO_ASAN
+#endif
+
+
+namespace wpp { namespace {
+	[[maybe_unused]] inline unsigned first_bit(uint32_t mask) {
+		#if defined(_MSC_VER) and not defined(__clang__)
+			unsigned long i;
+			_BitScanForward(&i, mask);
+			return i;
+		#else
+			return __builtin_ctz(mask);
+		#endif
+	}
+
+
+	namespace scalar {
+		constexpr bool is_blank(char c) {
+			return c == ' ' or (c >= '\t' and c <= '\r');
+		}
+
+		[[maybe_unused]] const char* string(const char* ptr) {
+			while (*ptr != '\\' and *ptr != '"' and *ptr != '\'' and *ptr != '\0')
+				++ptr;
+
+			return ptr;
+		}
+
+		[[maybe_unused]] const char* raw_string(const char* ptr) {
+			while (*ptr != '"' and *ptr != '\'' and *ptr != '\0')
+				++ptr;
+
+			return ptr;
+		}
+
+		[[maybe_unused]] const char* text(const char* ptr) {
+			while (
+				*ptr != '\\' and *ptr != '"' and *ptr != '\'' and
+				static_cast<unsigned char>(*ptr) > ' ' and
+				static_cast<unsigned char>(*ptr) < 0x80
+			)
+				++ptr;
+
+			return ptr;
+		}
+
+		[[maybe_unused]] const char* comment(const char* ptr) {
+			while (*ptr != '#' and *ptr != ']' and *ptr != '\0')
+				++ptr;
+
+			return ptr;
+		}
+
+		[[maybe_unused]] const char* blanks(const char* ptr) {
+			while (is_blank(*ptr))
+				++ptr;
+
+			return ptr;
+		}
+	}
+
+
+	#if defined(WPP_SCAN_SSE2)
+		namespace sse2 {
+			inline __m128i eq(__m128i v, char c) {
+				return _mm_cmpeq_epi8(v, _mm_set1_epi8(c));
+			}
+
+			// Bytes are compared as signed so anything >= 0x80 is negative.
+			inline __m128i lt(__m128i v, char c) {
+				return _mm_cmplt_epi8(v, _mm_set1_epi8(c));
+			}
+
+			inline __m128i gt(__m128i v, char c) {
+				return _mm_cmpgt_epi8(v, _mm_set1_epi8(c));
+			}
+
+			inline uint32_t mask(__m128i v) {
+				return static_cast<uint32_t>(_mm_movemask_epi8(v));
+			}
+
+
+			// Find the first byte for which `match` sets a bit. The first
+			// load is rounded down to an aligned block and the bits for
+			// the bytes before `ptr` are shifted away.
+			template <typename F>
+			WPP_NO_ASAN const char* find(const char* ptr, F match) {
+				const size_t skip = reinterpret_cast<uintptr_t>(ptr) % 16;
+				const char* block = ptr - skip;
+
+				if (uint32_t bits = match(_mm_load_si128(reinterpret_cast<const __m128i*>(block))) >> skip)
+					return ptr + first_bit(bits);
+
+				while (true) {
+					block += 16;
+
+					if (uint32_t bits = match(_mm_load_si128(reinterpret_cast<const __m128i*>(block))))
+						return block + first_bit(bits);
+				}
+			}
+
+
+			const char* string(const char* ptr) {
+				return find(ptr, [] (__m128i v) {
+					return mask(_mm_or_si128(
+						_mm_or_si128(eq(v, '\\'), eq(v, '"')),
+						_mm_or_si128(eq(v, '\''), eq(v, '\0'))
+					));
+				});
+			}
+
+			const char* raw_string(const char* ptr) {
+				return find(ptr, [] (__m128i v) {
+					return mask(_mm_or_si128(
+						_mm_or_si128(eq(v, '"'), eq(v, '\'')),
+						eq(v, '\0')
+					));
+				});
+			}
+
+			const char* text(const char* ptr) {
+				return find(ptr, [] (__m128i v) {
+					return mask(_mm_or_si128(
+						_mm_or_si128(eq(v, '\\'), eq(v, '"')),
+						_mm_or_si128(eq(v, '\''), lt(v, ' ' + 1))
+					));
+				});
+			}
+
+			const char* comment(const char* ptr) {
+				return find(ptr, [] (__m128i v) {
+					return mask(_mm_or_si128(
+						_mm_or_si128(eq(v, '#'), eq(v, ']')),
+						eq(v, '\0')
+					));
+				});
+			}
+
+			const char* blanks(const char* ptr) {
+				return find(ptr, [] (__m128i v) {
+					const __m128i blank = _mm_or_si128(eq(v, ' '), _mm_and_si128(gt(v, '\t' - 1), lt(v, '\r' + 1)));
+					return mask(blank) ^ 0xFFFFu;
+				});
+			}
+		}
+	#endif
+
+
+	#if defined(WPP_SCAN_AVX2)
+		#if defined(__clang__)
+			#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+		#else
+			#pragma GCC push_options
+			#pragma GCC target("avx2")
+		#endif
+
+		namespace avx2 {
+			inline __m256i eq(__m256i v, char c) {
+				return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c));
+			}
+
+			inline __m256i lt(__m256i v, char c) {
+				return _mm256_cmpgt_epi8(_mm256_set1_epi8(c), v);
+			}
+
+			inline __m256i gt(__m256i v, char c) {
+				return _mm256_cmpgt_epi8(v, _mm256_set1_epi8(c));
+			}
+
+			inline uint32_t mask(__m256i v) {
+				return static_cast<uint32_t>(_mm256_movemask_epi8(v));
+			}
+
+
+			template <typename F>
+			WPP_NO_ASAN const char* find(const char* ptr, F match) {
+				const size_t skip = reinterpret_cast<uintptr_t>(ptr) % 32;
+				const char* block = ptr - skip;
+
+				if (uint32_t bits = match(_mm256_load_si256(reinterpret_cast<const __m256i*>(block))) >> skip)
+					return ptr + first_bit(bits);
+
+				while (true) {
+					block += 32;
+
+					if (uint32_t bits = match(_mm256_load_si256(reinterpret_cast<const __m256i*>(block))))
+						return block + first_bit(bits);
+				}
+			}
+
+
+			const char* string(const char* ptr) {
+				return find(ptr, [] (__m256i v) {
+					return mask(_mm256_or_si256(
+						_mm256_or_si256(eq(v, '\\'), eq(v, '"')),
+						_mm256_or_si256(eq(v, '\''), eq(v, '\0'))
+					));
+				});
+			}
+
+			const char* raw_string(const char* ptr) {
+				return find(ptr, [] (__m256i v) {
+					return mask(_mm256_or_si256(
+						_mm256_or_si256(eq(v, '"'), eq(v, '\'')),
+						eq(v, '\0')
+					));
+				});
+			}
+
+			const char* text(const char* ptr) {
+				return find(ptr, [] (__m256i v) {
+					return mask(_mm256_or_si256(
+						_mm256_or_si256(eq(v, '\\'), eq(v, '"')),
+						_mm256_or_si256(eq(v, '\''), lt(v, ' ' + 1))
+					));
+				});
+			}
+
+			const char* comment(const char* ptr) {
+				return find(ptr, [] (__m256i v) {
+					return mask(_mm256_or_si256(
+						_mm256_or_si256(eq(v, '#'), eq(v, ']')),
+						eq(v, '\0')
+					));
+				});
+			}
+
+			const char* blanks(const char* ptr) {
+				return find(ptr, [] (__m256i v) {
+					const __m256i blank = _mm256_or_si256(eq(v, ' '), _mm256_and_si256(gt(v, '\t' - 1), lt(v, '\r' + 1)));
+					return ~mask(blank);
+				});
+			}
+		}
+
+		#if defined(__clang__)
+			#pragma clang attribute pop
+		#else
+			#pragma GCC pop_options
+		#endif
+	#endif
+
+
+	struct Scanners {
+		const char* (*string)(const char*);
+		const char* (*raw_string)(const char*);
+		const char* (*text)(const char*);
+		const char* (*comment)(const char*);
+		const char* (*blanks)(const char*);
+	};
+
+
+	Scanners select_scanners() {
+		#if defined(WPP_SCAN_AVX2)
+			__builtin_cpu_init();
+
+			if (__builtin_cpu_supports("avx2"))
+				return { avx2::string, avx2::raw_string, avx2::text, avx2::comment, avx2::blanks };
+		#endif
+
+		#if defined(WPP_SCAN_SSE2)
+			return { sse2::string, sse2::raw_string, sse2::text, sse2::comment, sse2::blanks };
+		#else
+			return { scalar::string, scalar::raw_string, scalar::text, scalar::comment, scalar::blanks };
+		#endif
+	}
+
+
+	const Scanners scanners = select_scanners();
+}}
+
+
+namespace wpp {
+	const char* scan_string(const char* ptr) {
+		return scanners.string(ptr);
+	}
+
+	const char* scan_raw_string(const char* ptr) {
+		return scanners.raw_string(ptr);
+	}
+
+	const char* scan_text(const char* ptr) {
+		return scanners.text(ptr);
+	}
+
+	const char* scan_comment(const char* ptr) {
+		return scanners.comment(ptr);
+	}
+
+	const char* skip_blanks(const char* ptr) {
+		return scanners.blanks(ptr);
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#ifndef WOTPP_SCAN
+#define WOTPP_SCAN
+
+// Vectorised scanners used by the lexer to skip over runs of uninteresting
+// bytes. Each one returns a pointer to the first byte which the lexer has
+// to look at itself and always stops at the null terminator.
+//
+// Every delimiter we look for is ASCII and UTF-8 continuation bytes can
+// never be mistaken for ASCII so we can scan bytes rather than codepoints.
+// Loads are aligned so a scan never touches a page past the terminator.
+
+namespace wpp {
+	// First of `\`, `"`, `'` or EOF.
+	const char* scan_string(const char*);
+
+	// First of `"`, `'` or EOF.
+	const char* scan_raw_string(const char*);
+
+	// First of `\`, `"`, `'`, EOF, an ASCII control or whitespace character
+	// or a non-ASCII byte. The caller decides if it actually ends the text.
+	const char* scan_text(const char*);
+
+	// First of `#`, `]` or EOF.
+	const char* scan_comment(const char*);
+
+	// First byte which is not ASCII whitespace.
+	const char* skip_blanks(const char*);
+}
+
+#endif
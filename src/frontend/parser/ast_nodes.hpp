@@ -7,6 +7,7 @@
 #include <string>
 #include <vector>
 
+#include <structures/str.hpp>
 #include <frontend/token.hpp>
 #include <frontend/view.hpp>
 #include <frontend/ast.hpp>
@@ -67,32 +68,32 @@ namespace wpp {
 
 	// A function call.
 	struct FnInvoke {
-		std::vector<wpp::node_t> arguments{};
-		wpp::View identifier{};
+		wpp::List<wpp::node_t> arguments{};
+		wpp::symbol_t symbol{};
 
 		FnInvoke(
-			const std::vector<wpp::node_t>& arguments_,
-			const wpp::View& identifier_
+			const wpp::List<wpp::node_t>& arguments_,
+			const wpp::symbol_t symbol_
 		):
 			arguments(arguments_),
-			identifier(identifier_) {}
+			symbol(symbol_) {}
 
 		FnInvoke() {}
 	};
 
 	// Function definition.
 	struct Fn {
-		std::vector<wpp::View> parameters{};
-		wpp::View identifier{};
+		wpp::List<wpp::symbol_t> parameters{};
+		wpp::symbol_t symbol{};
 		wpp::node_t body{};
 
 		Fn(
-			const std::vector<wpp::View>& parameters_,
-			const wpp::View& identifier_,
+			const wpp::List<wpp::symbol_t>& parameters_,
+			const wpp::symbol_t symbol_,
 			const wpp::node_t body_
 		):
 			parameters(parameters_),
-			identifier(identifier_),
+			symbol(symbol_),
 			body(body_) {}
 
 		Fn() {}
@@ -100,22 +101,24 @@ namespace wpp {
 
 	// A variable reference.
 	struct VarRef {
-		wpp::View identifier{};
+		wpp::symbol_t symbol{};
+		int32_t slot = -1;   // Parameter index in the enclosing function, -1 if unknown at parse time.
 
-		VarRef(const wpp::View& identifier_): identifier(identifier_) {}
+		VarRef(const wpp::symbol_t symbol_, const int32_t slot_):
+			symbol(symbol_), slot(slot_) {}
 		VarRef() {}
 	};
 
 	// Variable definition.
 	struct Var {
-		wpp::View identifier{};
+		wpp::symbol_t symbol{};
 		wpp::node_t body{};
 
 		Var(
-			const wpp::View& identifier_,
+			const wpp::symbol_t symbol_,
 			const wpp::node_t body_
 		):
-			identifier(identifier_),
+			symbol(symbol_),
 			body(body_) {}
 
 		Var() {}
@@ -130,22 +133,22 @@ namespace wpp {
 
 
 	struct Drop {
-		wpp::View identifier{};
-		size_t n_args{};
+		wpp::symbol_t symbol{};
+		uint32_t n_args{};
 		bool is_variadic{};
 
-		Drop(const wpp::View& identifier_, size_t n_args_, bool is_variadic_):
-			identifier(identifier_), n_args(n_args_), is_variadic(is_variadic_) {}
+		Drop(wpp::symbol_t symbol_, uint32_t n_args_, bool is_variadic_):
+			symbol(symbol_), n_args(n_args_), is_variadic(is_variadic_) {}
 
 		Drop() {}
 	};
 
 
-	// String literal.
+	// String literal. The value is stored in `AST::strings`.
 	struct String {
-		std::string value{};
+		uint32_t value{};
 
-		String(const std::string& value_): value(value_) {}
+		String(uint32_t value_): value(value_) {}
 		String() {}
 	};
 
@@ -159,11 +162,11 @@ namespace wpp {
 
 	// Block of zero or more statements and trailing expression.
 	struct Block {
-		std::vector<wpp::node_t> statements{};
+		wpp::List<wpp::node_t> statements{};
 		wpp::node_t expr{};
 
 		Block(
-			const std::vector<wpp::node_t>& statements_,
+			const wpp::List<wpp::node_t>& statements_,
 			const wpp::node_t expr_
 		):
 			statements(statements_),
@@ -173,13 +176,14 @@ namespace wpp {
 	};
 
 	// Match strings to new strings.
+	// Cases are stored as pairs of arm followed by hand.
 	struct Match {
-		std::vector<std::pair<wpp::node_t, wpp::node_t>> cases{};
+		wpp::List<wpp::node_t> cases{};
 		wpp::node_t expr{};
 		wpp::node_t default_case{};
 
 		Match(
-			const std::vector<std::pair<wpp::node_t, wpp::node_t>>& cases_,
+			const wpp::List<wpp::node_t>& cases_,
 			const wpp::node_t expr_,
 			const wpp::node_t default_case_
 		):
@@ -199,24 +203,24 @@ namespace wpp {
 
 	// The root node of a wot++ program.
 	struct Document {
-		std::vector<wpp::node_t> statements{};
+		wpp::List<wpp::node_t> statements{};
 
-		Document(const std::vector<wpp::node_t>& statements_): statements(statements_) {}
+		Document(const wpp::List<wpp::node_t>& statements_): statements(statements_) {}
 		Document() {}
 	};
 
 	struct Pop {
-		std::vector<wpp::node_t> arguments{};
-		wpp::View identifier{};
-		size_t n_popped_args{};
+		wpp::List<wpp::node_t> arguments{};
+		wpp::symbol_t symbol{};
+		uint32_t n_popped_args{};
 
 		Pop(
-			const std::vector<wpp::node_t>& arguments_,
-			const wpp::View& identifier_,
-			size_t n_popped_args_
+			const wpp::List<wpp::node_t>& arguments_,
+			const wpp::symbol_t symbol_,
+			uint32_t n_popped_args_
 		):
 			arguments(arguments_),
-			identifier(identifier_),
+			symbol(symbol_),
 			n_popped_args(n_popped_args_) {}
 
 		Pop() {}
@@ -232,8 +236,8 @@ namespace wpp {
 	struct Slice {
 		wpp::node_t expr{};
 
-		wpp::View start{};
-		wpp::View stop{};
+		int32_t start{};
+		int32_t stop{};
 
 		enum {
 			SLICE_INDEX = 0b0000'0001,
@@ -241,16 +245,17 @@ namespace wpp {
 			SLICE_STOP  = 0b0000'0100,
 		};
 
-		uint8_t set;
+		uint8_t set{};
 
-		Slice(const wpp::node_t expr_, const wpp::View& start_, const wpp::View& stop_):
+		Slice(const wpp::node_t expr_, const int32_t start_, const int32_t stop_):
 			expr(expr_), start(start_), stop(stop_) {}
 
 		Slice() {}
 	};
 
-	// An alias for our AST.
-	using AST = wpp::HeterogenousVector<
+	// Nodes are kept small so that the tree is dense: children and
+	// parameters live in the shared `pool` and string payloads in `strings`.
+	using Nodes = wpp::HeterogenousVector<
 		IntrinsicUse,
 		IntrinsicFile,
 		IntrinsicPipe,
@@ -273,6 +278,41 @@ namespace wpp {
 		Document,
 		Drop
 	>;
+
+	// String payloads are kept as `Str`s rather than as ranges of a single
+	// byte arena. Most literals are slices of their source which cost no
+	// bytes of their own, short ones are stored inline, and evaluating a
+	// literal only has to share its `Str` where a range of an arena would
+	// have to be copied out every time. `--stats` reports what they cost.
+	struct AST: wpp::Nodes {
+		std::pmr::vector<wpp::Str> strings{};   // Values of `String` nodes.
+
+
+		AST() {}
+
+		explicit AST(std::pmr::memory_resource* resource):
+			wpp::Nodes(resource),
+			strings(resource) {}
+
+		// Store a string payload and return its index.
+		uint32_t add_string(std::string&& str) {
+			DBG();
+			strings.emplace_back(std::move(str));
+			return static_cast<uint32_t>(strings.size() - 1);
+		}
+
+		// Store a payload which is a verbatim piece of `source` (the text of a
+		// `Source`) without copying it.
+		uint32_t add_string(const wpp::Str& source, const char* const begin, const char* const end) {
+			DBG();
+			strings.emplace_back(source.slice(begin - source.data(), end - begin));
+			return static_cast<uint32_t>(strings.size() - 1);
+		}
+
+		const wpp::Str& string(const String& s) const {
+			return strings[s.value];
+		}
+	};
 }
 
 #endif
@@ -2,6 +2,7 @@
 #include <vector>
 #include <limits>
 #include <algorithm>
+#include <iterator>
 
 #include <misc/constants.hpp>
 #include <misc/fwddecl.hpp>
@@ -208,24 +209,48 @@ namespace wpp { namespace {
 		const wpp::node_t node = tree.add<String>();
 		meta.emplace_back(lex.position(), parent);
 
-		auto& str = tree.get<String>(node).value;
+		std::string str;
 
 		const auto delim = lex.advance(wpp::lexer_modes::string); // Store delimeter.
 
+		// A string without escapes is referenced in the source rather than
+		// copied out of it. We only start building `str` at the first escape.
+		// The views of hex and binary escapes start after their `\x` or `\b`
+		// so we keep where the previous token ended to find the backslash.
+		const char* const begin = delim.view.ptr + delim.view.length;
+		const char* prev_end = begin;
+		bool has_escapes = false;
+
 		// Consume tokens until we reach `delim` or EOF.
 		while (lex.peek(wpp::lexer_modes::string) != delim) {
 			if (lex.peek(wpp::lexer_modes::string) == TOKEN_EOF)
 				wpp::error(report_modes::syntax, node, env, "unterminated string", "reached EOF while parsing string literal that begins here");
 
+			const auto token = lex.advance(wpp::lexer_modes::string);
+
 			// Parse escape characters and append "parts" of the string to `str`.
-			if (peek_is_escape(lex.peek(wpp::lexer_modes::string)))
-				str += wpp::handle_escapes(lex.advance(wpp::lexer_modes::string));
+			if (peek_is_escape(token)) {
+				if (not has_escapes)
+					str.assign(begin, prev_end);
 
-			else
-				str += lex.advance(wpp::lexer_modes::string).str();
+				has_escapes = true;
+				str += wpp::handle_escapes(token);
+			}
+
+			else if (has_escapes)
+				str.append(token.view.ptr, token.view.length);
+
+			prev_end = token.view.ptr + token.view.length;
 		}
 
-		lex.advance(); // Skip terminating quote.
+		const char* const end = lex.advance().view.ptr; // Skip terminating quote.
+
+		if (has_escapes)
+			wpp::track_utf8(str, env);
+
+		tree.get<String>(node).value = has_escapes ?
+			tree.add_string(std::move(str)) :
+			tree.add_string(env.sources.top().text, begin, end);
 
 		return node;
 	}
@@ -237,7 +262,8 @@ namespace wpp { namespace {
 		const wpp::node_t node = tree.add<String>();
 		meta.emplace_back(lex.position(), parent);
 
-		tree.get<String>(node).value = lex.advance().str();
+		const auto& [ptr, len] = lex.advance().view;
+		tree.get<String>(node).value = tree.add_string(env.sources.top().text, ptr, ptr + len);
 
 		return node;
 	}
@@ -248,11 +274,14 @@ namespace wpp { namespace {
 
 		const wpp::node_t node = tree.add<String>();
 		meta.emplace_back(lex.position(), parent);
-		auto& str = tree.get<String>(node).value;
 
 		const auto delim = lex.advance().view.at(1);  // User defined delimiter.
 		const auto quote = lex.advance(wpp::lexer_modes::string_raw); // ' or "
 
+		// Raw strings are always verbatim so they are referenced in the source.
+		const char* const begin = lex.peek(wpp::lexer_modes::string_raw).view.ptr;
+		const char* end = begin;
+
 		while (true) {
 			if (lex.peek(wpp::lexer_modes::string_raw) == TOKEN_EOF)
 				wpp::error(report_modes::syntax, node, env, "unterminated string", "reached EOF while parsing raw string literal that begins here");
@@ -267,19 +296,20 @@ namespace wpp { namespace {
 				const auto tmp = lex.advance(wpp::lexer_modes::string_raw);
 
 				if (lex.peek(wpp::lexer_modes::chr).view == delim) {
+					end = tmp.view.ptr;
 					lex.advance(wpp::lexer_modes::chr); // Skip user delimiter.
 					break;  // Exit the loop, string is fully consumed.
 				}
-
-				str += tmp.str();
 			}
 
 			// If not EOF or '/", consume.
 			else {
-				str += lex.advance(wpp::lexer_modes::string_raw).str();
+				lex.advance(wpp::lexer_modes::string_raw);
 			}
 		}
 
+		tree.get<String>(node).value = tree.add_string(env.sources.top().text, begin, end);
+
 		return node;
 	}
 
@@ -289,21 +319,28 @@ namespace wpp { namespace {
 
 		const wpp::node_t node = tree.add<String>();
 		meta.emplace_back(lex.position(), parent);
-		auto& str = tree.get<String>(node).value;
+		std::string str;
 
-		const auto delim = lex.advance(wpp::lexer_modes::string_para).view.at(1);  // User defined delimiter.
+		const auto delim = lex.advance().view.at(1);  // User defined delimiter.
 		const auto quote = lex.advance(wpp::lexer_modes::string_para); // ' or "
 
 
-		struct Part {
-			std::string str;
-			bool is_whitespace;
+		// The string is built in a single pass. We only need to remember
+		// where the last part started, whether it was whitespace, and where
+		// the last bit of text ended, to trim trailing whitespace.
+		size_t last_part = 0;
+		bool last_is_whitespace = false;
+		size_t text_end = 0;
 
-			Part(const std::string& str_, bool is_whitespace_):
-				str(str_), is_whitespace(is_whitespace_) {}
-		};
+		const auto append = [&] (std::string_view part, bool is_whitespace) {
+			last_part = str.size();
+			last_is_whitespace = is_whitespace;
 
-		std::vector<Part> chunks;
+			str += part;
+
+			if (not is_whitespace)
+				text_end = str.size();
+		};
 
 
 		while (wpp::eq_any(lex.peek(wpp::lexer_modes::string_para), TOKEN_WHITESPACE, TOKEN_WHITESPACE_NEWLINE))
@@ -331,7 +368,7 @@ namespace wpp { namespace {
 				}
 
 				// Quote was not a part of the string terminator so we append it.
-				chunks.emplace_back(tmp.str(), false);
+				append({ tmp.view.ptr, tmp.view.length }, false);
 			}
 
 			// If not EOF or '/", consume.
@@ -340,10 +377,10 @@ namespace wpp { namespace {
 
 				// Collapse pairs of newlines into a single newline and strip any loner newlines.
 				if (token == TOKEN_WHITESPACE_NEWLINE) {
-					if (not chunks.empty() and chunks.back().is_whitespace)
-						chunks.pop_back();
+					if (last_is_whitespace)
+						str.resize(last_part);
 
-					chunks.emplace_back(token.str(), true);
+					append({ token.view.ptr, token.view.length }, true);
 
 					// If this newline has whitespace after it, we have to check
 					// how much whitespace there is to track indentation level.
@@ -353,31 +390,24 @@ namespace wpp { namespace {
 
 				// Collapse repeated whitespace of the same type.
 				else if (token == TOKEN_WHITESPACE)
-					chunks.emplace_back(wpp::collapse_repeated(token.str()), true);
+					append(wpp::collapse_repeated(token.str()), true);
 
 				// Handle escape sequences.
 				else if (peek_is_escape(token))
-					chunks.emplace_back(wpp::handle_escapes(token), false);
+					append(wpp::handle_escapes(token), false);
 
 				// Otherwise just append the textual parts of the string.
 				else
-					chunks.emplace_back(token.str(), false);
+					append({ token.view.ptr, token.view.length }, false);
 			}
 		}
 
 
 		// Trim trailing whitespace.
-		if (not chunks.empty()) {
-			auto it = chunks.rbegin();
-			while (it->is_whitespace)
-				++it;
+		str.resize(text_end);
 
-			chunks.erase(it.base(), chunks.end());
-
-			// Join chunks.
-			for (const auto& [chunk, is_whitespace]: chunks)
-				str += chunk;
-		}
+		wpp::track_utf8(str, env);
+		tree.get<String>(node).value = tree.add_string(std::move(str));
 
 		return node;
 	}
@@ -388,9 +418,9 @@ namespace wpp { namespace {
 
 		const wpp::node_t node = tree.add<String>();
 		meta.emplace_back(lex.position(), parent);
-		auto& str = tree.get<String>(node).value;
+		std::string str;
 
-		const auto delim = lex.advance(wpp::lexer_modes::string_code).view.at(1);  // User defined delimiter.
+		const auto delim = lex.advance().view.at(1);  // User defined delimiter.
 		const auto quote = lex.advance(wpp::lexer_modes::string_code); // ' or "
 
 		enum {
@@ -400,28 +430,36 @@ namespace wpp { namespace {
 			KIND_OTHER,
 		};
 
+		// Parts refer to the source, or to `escapes` for escape sequences, so
+		// that no text is copied until the string is joined.
 		struct Part {
-			std::string str;
+			uint32_t offset;
+			uint32_t length;
 			uint8_t kind;
-
-			Part(const std::string& str_, uint8_t kind_):
-				str(str_), kind(kind_) {}
+			bool is_escape = false;
 		};
 
 		std::vector<Part> chunks;
+		std::string escapes;
+
+		const char* const base = env.sources.top().base;
+
+		const auto part = [&] (const wpp::Token& token, uint8_t kind) {
+			return Part{ static_cast<uint32_t>(token.view.ptr - base), token.view.length, kind };
+		};
 
 
 		// Check if the first token is whitespace and then check if its followed
 		// by text.
 		// If it is followed by text, this whitespace is leading.
 		if (lex.peek(wpp::lexer_modes::string_code) == TOKEN_WHITESPACE) {
-			const auto tmp = lex.advance(wpp::lexer_modes::string_code).str();
+			const auto tmp = lex.advance(wpp::lexer_modes::string_code);
 
 			if (not wpp::eq_any(lex.peek(wpp::lexer_modes::string_code), TOKEN_WHITESPACE, TOKEN_WHITESPACE_NEWLINE))
-				chunks.emplace_back(tmp, KIND_LEADING);
+				chunks.emplace_back(part(tmp, KIND_LEADING));
 
 			else
-				chunks.emplace_back(tmp, KIND_WHITESPACE);
+				chunks.emplace_back(part(tmp, KIND_WHITESPACE));
 		}
 
 
@@ -444,7 +482,7 @@ namespace wpp { namespace {
 				}
 
 				// Quote was not a part of the string terminator so we append it.
-				chunks.emplace_back(tmp.str(), KIND_OTHER);
+				chunks.emplace_back(part(tmp, KIND_OTHER));
 			}
 
 			// If not EOF or '/", consume.
@@ -453,27 +491,31 @@ namespace wpp { namespace {
 
 				// Check for newline followed by whitespace.
 				if (token == TOKEN_WHITESPACE_NEWLINE) {
-					chunks.emplace_back(token.str(), KIND_NEWLINE);
+					chunks.emplace_back(part(token, KIND_NEWLINE));
 
 					// If this newline has whitespace after it, we have to check
 					// how much whitespace there is to track indentation level.
 					if (lex.peek(wpp::lexer_modes::string_code) == TOKEN_WHITESPACE)
-						chunks.emplace_back(lex.advance(wpp::lexer_modes::string_code).str(), KIND_LEADING);
+						chunks.emplace_back(part(lex.advance(wpp::lexer_modes::string_code), KIND_LEADING));
 
 					else
-						chunks.emplace_back("", KIND_LEADING);
+						chunks.emplace_back(Part{ 0, 0, KIND_LEADING });
 				}
 
 				else if (token == TOKEN_WHITESPACE)
-					chunks.emplace_back(token.str(), KIND_WHITESPACE);
+					chunks.emplace_back(part(token, KIND_WHITESPACE));
 
 				// Handle escape sequences.
-				else if (peek_is_escape(token))
-					chunks.emplace_back(wpp::handle_escapes(token), KIND_OTHER);
+				else if (peek_is_escape(token)) {
+					const auto offset = static_cast<uint32_t>(escapes.size());
+					escapes += wpp::handle_escapes(token);
+
+					chunks.emplace_back(Part{ offset, static_cast<uint32_t>(escapes.size() - offset), KIND_OTHER, true });
+				}
 
 				// Otherwise just append the textual parts of the string.
 				else
-					chunks.emplace_back(token.str(), KIND_OTHER);
+					chunks.emplace_back(part(token, KIND_OTHER));
 			}
 		}
 
@@ -513,34 +555,42 @@ namespace wpp { namespace {
 		// Discover common leading whitespace amount.
 		size_t common_leading_whitespace = std::numeric_limits<size_t>::max();
 
-		for (const auto& [chunk, kind]: chunks) {
-			if (kind == KIND_LEADING and chunk.size() < common_leading_whitespace)
-				common_leading_whitespace = chunk.size();
+		for (const Part& chunk: chunks) {
+			if (chunk.kind == KIND_LEADING and chunk.length < common_leading_whitespace)
+				common_leading_whitespace = chunk.length;
 		}
 
 
 		// Join chunks.
-		for (auto& [chunk, kind]: chunks) {
+		for (const Part& chunk: chunks) {
+			const char* ptr = (chunk.is_escape ? escapes.data() : base) + chunk.offset;
+			size_t length = chunk.length;
+
 			// If this chunk is leading whitespace, strip up to `common_leading_whitespace` from the front.
-			if (kind == KIND_LEADING)
-				chunk.erase(chunk.begin(), chunk.begin() + common_leading_whitespace);
+			if (chunk.kind == KIND_LEADING) {
+				ptr += common_leading_whitespace;
+				length -= common_leading_whitespace;
+			}
 
-			str += chunk;
+			str.append(ptr, length);
 		}
 
 
+		wpp::track_utf8(str, env);
+		tree.get<String>(node).value = tree.add_string(std::move(str));
+
 		return node;
 	}
 
 
-	wpp::node_t hex_string(wpp::node_t parent, wpp::Lexer& lex, wpp::AST& tree, wpp::ASTMeta& meta, wpp::Env&) {
+	wpp::node_t hex_string(wpp::node_t parent, wpp::Lexer& lex, wpp::AST& tree, wpp::ASTMeta& meta, wpp::Env& env) {
 		DBG();
 
 		const auto& [ptr, len] = lex.advance().view;
 
 		const wpp::node_t node = tree.add<String>();
 		meta.emplace_back(lex.position(), parent);
-		auto& str = tree.get<String>(node).value;
+		std::string str;
 
 		size_t counter = 0; // index into string, doesnt count `_`.
 
@@ -564,16 +614,19 @@ namespace wpp { namespace {
 
 		std::reverse(str.begin(), str.end());
 
+		wpp::track_utf8(str, env);
+		tree.get<String>(node).value = tree.add_string(std::move(str));
+
 		return node;
 	}
 
 
-	wpp::node_t bin_string(wpp::node_t parent, wpp::Lexer& lex, wpp::AST& tree, wpp::ASTMeta& meta, wpp::Env&) {
+	wpp::node_t bin_string(wpp::node_t parent, wpp::Lexer& lex, wpp::AST& tree, wpp::ASTMeta& meta, wpp::Env& env) {
 		DBG();
 
 		const wpp::node_t node = tree.add<String>();
 		meta.emplace_back(lex.position(), parent);
-		auto& str = tree.get<String>(node).value;
+		std::string str;
 
 		const auto& [ptr, len] = lex.advance().view;
 
@@ -602,6 +655,9 @@ namespace wpp { namespace {
 
 		std::reverse(str.begin(), str.end());
 
+		wpp::track_utf8(str, env);
+		tree.get<String>(node).value = tree.add_string(std::move(str));
+
 		return node;
 	}
 
@@ -657,13 +713,16 @@ namespace wpp { namespace {
 		if (lex.peek() != TOKEN_IDENTIFIER)
 			wpp::error(report_modes::syntax, lex.position(), env, "expected identifier", "expecting an identifier to follow `let`");
 
-		tree.get<Fn>(node).identifier = lex.advance().view;
+		const auto identifier = lex.advance().view;
+		const auto symbol = env.symbols.intern(identifier);
+
+		tree.get<Fn>(node).symbol = symbol;
 
 
 		// Variable definition
 		if (peek_is_expr(lex.peek())) {
 			const wpp::node_t expr = wpp::expression(parent, lex, tree, meta, env);
-			tree.replace<Var>(node, tree.get<Fn>(node).identifier, expr);
+			tree.replace<Var>(node, symbol, expr);
 			return node;
 		}
 
@@ -675,20 +734,21 @@ namespace wpp { namespace {
 		lex.advance();  // Skip `(`.
 
 
+		std::vector<wpp::symbol_t> param_vec;
+
 		if (lex.peek() != TOKEN_RPAREN) {
 			// Collect parameters.
 			// Advance until we run out of identifiers.
 			// While there is an identifier there is another parameter.
 			while (lex.peek() == TOKEN_IDENTIFIER) {
-				const auto param_view = lex.peek().view;
-				auto& param_vec = tree.get<Fn>(node).parameters;
+				const auto param = env.symbols.intern(lex.peek().view);
 
-				if (std::find(param_vec.begin(), param_vec.end(), param_view) != param_vec.end())
+				if (std::find(param_vec.begin(), param_vec.end(), param) != param_vec.end())
 					wpp::error(report_modes::syntax, lex.position(), env, "duplicate parameter",
 						"multiple occurences of the same identifier in parameter list"
 					);
 
-				param_vec.emplace_back(param_view);
+				param_vec.emplace_back(param);
 				lex.advance();
 
 				if (lex.peek() == TOKEN_COMMA)
@@ -715,8 +775,23 @@ namespace wpp { namespace {
 
 		lex.advance();
 
-		// Parse the function body.
-		const wpp::node_t body = expression(parent, lex, tree, meta, env);
+		tree.get<Fn>(node).parameters = tree.add_list(param_vec);
+
+		// Parse the function body. References to parameters inside of the
+		// body are resolved to argument slots as they are parsed.
+		env.fn_scopes.emplace_back(node);
+		wpp::node_t body = wpp::NODE_EMPTY;
+
+		try {
+			body = expression(parent, lex, tree, meta, env);
+		}
+
+		catch (const wpp::Report&) {
+			env.fn_scopes.pop_back();
+			throw;
+		}
+
+		env.fn_scopes.pop_back();
 		tree.get<Fn>(node).body = body;
 
 		return node;
@@ -757,8 +832,7 @@ namespace wpp { namespace {
 			wpp::error(report_modes::syntax, node, env, "expected identifier", "expecting identifier to follow `drop`");
 
 
-		const auto identifier = lex.advance().view;
-		tree.get<Drop>(node).identifier = identifier;
+		tree.get<Drop>(node).symbol = env.symbols.intern(lex.advance().view);
 
 
 		lex.advance();  // Skip `(`.
@@ -836,7 +910,7 @@ namespace wpp { namespace {
 		if (lex.peek() != TOKEN_IDENTIFIER)
 			wpp::error(report_modes::syntax, lex.position(), env, "expected identifier", "expecting identifier to follow `pop`");
 
-		tree.get<Pop>(node).identifier = lex.advance().view;
+		tree.get<Pop>(node).symbol = env.symbols.intern(lex.advance().view);
 
 
 		if (lex.peek() != TOKEN_LPAREN)
@@ -845,17 +919,21 @@ namespace wpp { namespace {
 		lex.advance();  // Skip `(`.
 
 
+		std::vector<wpp::node_t> args;
+
 		if (lex.peek() != TOKEN_RPAREN) {
 			// While there is an expression there is another parameter.
 			while (peek_is_expr(lex.peek())) {
 				wpp::node_t expr = expression(parent, lex, tree, meta, env);
-				tree.get<Pop>(node).arguments.emplace_back(expr);
+				args.emplace_back(expr);
 
 				if (lex.peek() == TOKEN_COMMA)
 					lex.advance();
 			}
 		}
 
+		tree.get<Pop>(node).arguments = tree.add_list(args);
+
 
 		if (lex.peek() != TOKEN_STAR)
 			wpp::error(report_modes::syntax, node, env, "no substitute argument",
@@ -893,27 +971,43 @@ namespace wpp { namespace {
 		wpp::node_t node = tree.add<FnInvoke>();
 		meta.emplace_back(lex.position(), parent);
 
-		tree.get<FnInvoke>(node).identifier = lex.advance().view;
+		const auto identifier = lex.advance().view;
+		const auto symbol = env.symbols.intern(identifier);
+
+		tree.get<FnInvoke>(node).symbol = symbol;
 
 		// Optional arguments.
 		if (lex.peek() != TOKEN_LPAREN) {
-			tree.replace<VarRef>(node, tree.get<FnInvoke>(node).identifier);
+			int32_t slot = -1;
+
+			if (not env.fn_scopes.empty()) {
+				const auto params = tree.list(tree.get<Fn>(env.fn_scopes.back()).parameters);
+
+				if (auto it = std::find(params.begin(), params.end(), symbol); it != params.end())
+					slot = std::distance(params.begin(), it);
+			}
+
+			tree.replace<VarRef>(node, symbol, slot);
 			return node;
 		}
 
 
 		lex.advance();  // Skip `(`.
 
+		std::vector<wpp::node_t> args;
+
 		// While there is an expression there is another parameter.
 		while (peek_is_expr(lex.peek())) {
 			// Parse expr.
 			wpp::node_t expr = expression(parent, lex, tree, meta, env);
-			tree.get<FnInvoke>(node).arguments.emplace_back(expr);
+			args.emplace_back(expr);
 
 			if (lex.peek() == TOKEN_COMMA)
 				lex.advance();
 		}
 
+		tree.get<FnInvoke>(node).arguments = tree.add_list(args);
+
 		// Make sure parameter list is terminated by `)`.
 		if (lex.advance() != TOKEN_RPAREN)
 			wpp::error(report_modes::syntax, lex.position(), env, "expected `)`",
@@ -946,6 +1040,7 @@ namespace wpp { namespace {
 		// the last statement to consider it as the trailing expression
 		// of the block.
 		bool last_is_expr = false;
+		std::vector<wpp::node_t> stmts;
 
 		if (peek_is_stmt(lex.peek())) {
 			// Consume statements.
@@ -953,7 +1048,7 @@ namespace wpp { namespace {
 				last_is_expr = peek_is_expr(lex.peek());
 
 				const wpp::node_t stmt = statement(parent, lex, tree, meta, env);
-				tree.get<Block>(node).statements.emplace_back(stmt);
+				stmts.emplace_back(stmt);
 			} while (peek_is_stmt(lex.peek()));
 		}
 
@@ -962,8 +1057,10 @@ namespace wpp { namespace {
 		// was an expression then we can pop the last statement and use
 		// it as our trailing expression.
 		if (not peek_is_expr(lex.peek()) and last_is_expr) {
-			tree.get<Block>(node).expr = tree.get<Block>(node).statements.back();
-			tree.get<Block>(node).statements.pop_back();
+			tree.get<Block>(node).expr = stmts.back();
+			stmts.pop_back();
+
+			tree.get<Block>(node).statements = tree.add_list(stmts);
 		}
 
 		else {
@@ -1020,6 +1117,8 @@ namespace wpp { namespace {
 
 
 		// Collect all arms of the match.
+		std::vector<wpp::node_t> cases;
+
 		while (peek_is_expr(lex.peek())) {
 			const auto arm = wpp::expression(parent, lex, tree, meta, env);
 
@@ -1035,9 +1134,12 @@ namespace wpp { namespace {
 
 			const auto hand = wpp::expression(parent, lex, tree, meta, env);
 
-			tree.get<Match>(node).cases.emplace_back(std::pair{ arm, hand });
+			cases.emplace_back(arm);
+			cases.emplace_back(hand);
 		}
 
+		tree.get<Match>(node).cases = tree.add_list(cases);
+
 
 		// Optional default case.
 		if (lex.peek() == TOKEN_STAR) {
@@ -1170,7 +1272,7 @@ namespace wpp { namespace {
 
 			// Index/Start
 			if (lex.peek(lexer_modes::slice) == TOKEN_INT) {
-				tree.get<Slice>(node).start = lex.advance(lexer_modes::slice).view;
+				tree.get<Slice>(node).start = wpp::dec_to_int_view(lex.advance(lexer_modes::slice).view);
 
 				// Check for `:`. If we find one, the first integer literal was
 				// actually the start index of a slice and not an index.
@@ -1180,7 +1282,7 @@ namespace wpp { namespace {
 
 					// Stop
 					if (lex.peek(lexer_modes::slice) == TOKEN_INT) {
-						tree.get<Slice>(node).stop = lex.advance(lexer_modes::slice).view;
+						tree.get<Slice>(node).stop = wpp::dec_to_int_view(lex.advance(lexer_modes::slice).view);
 						tree.get<Slice>(node).set |= Slice::SLICE_STOP;
 					}
 				}
@@ -1198,7 +1300,7 @@ namespace wpp { namespace {
 						"expecting an integer literal for stop index"
 					);
 
-				tree.get<Slice>(node).stop = lex.advance(lexer_modes::slice).view;
+				tree.get<Slice>(node).stop = wpp::dec_to_int_view(lex.advance(lexer_modes::slice).view);
 			}
 
 
@@ -1272,11 +1374,13 @@ namespace wpp {
 		const wpp::node_t node = tree.add<Document>();
 		meta.emplace_back(lex.position(), parent);
 
+		std::vector<wpp::node_t> stmts;
+
 		// Consume expressions until we encounter eof or an error.
 		while (lex.peek() != TOKEN_EOF) {
 			try {
 				const wpp::node_t stmt = statement(parent, lex, tree, meta, env);
-				tree.get<Document>(node).statements.emplace_back(stmt);
+				stmts.emplace_back(stmt);
 			}
 
 			catch (const wpp::Report& e) {
@@ -1312,6 +1416,8 @@ namespace wpp {
 			}
 		}
 
+		tree.get<Document>(node).statements = tree.add_list(stmts);
+
 		return node;
 	}
 }
@@ -3,7 +3,10 @@
 #ifndef WOTPP_PARSER
 #define WOTPP_PARSER
 
+#include <algorithm>
+
 #include <misc/fwddecl.hpp>
+#include <misc/constants.hpp>
 #include <structures/environment.hpp>
 #include <frontend/lexer/lexer.hpp>
 
@@ -13,7 +16,26 @@
 namespace wpp {
 	wpp::node_t document(wpp::node_t, wpp::Lexer&, wpp::AST&, wpp::ASTMeta&, wpp::Env&);
 
+	// Make room for the nodes of the source about to be parsed so that a
+	// large file doesn't grow the tree one doubling at a time. Small sources
+	// parsed by `!` fit in the existing capacity and leave it alone.
+	inline void reserve_nodes(wpp::Env& env) {
+		auto& ast = env.ast;
+		const size_t n = ast.size() + env.sources.top().size / wpp::BYTES_PER_NODE + 1;
+
+		if (n <= ast.capacity())
+			return;
+
+		const size_t capacity = std::max(n, ast.capacity() * 2);
+
+		ast.reserve(capacity);
+		env.ast_meta.reserve(capacity);
+	}
+
+
 	inline wpp::node_t parse(wpp::Env& env, wpp::node_t parent = wpp::NODE_ROOT) {
+		wpp::reserve_nodes(env);
+
 		wpp::Lexer lex{ env };
 		return wpp::document(parent, lex, env.ast, env.ast_meta, env);
 	}
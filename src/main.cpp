@@ -5,12 +5,16 @@
 #include <vector>
 #include <iostream>
 #include <utility>
+#include <charconv>
+#include <cstdint>
 
 #include <misc/flags.hpp>
+#include <misc/constants.hpp>
 #include <misc/util/util.hpp>
 #include <misc/repl.hpp>
 #include <misc/argp.hpp>
 #include <backend/eval/eval.hpp>
+#include <backend/vm/vm.hpp>
 #include <frontend/parser/parser.hpp>
 
 #ifdef WPP_ENABLE_OVERFLOW_DETECTOR
@@ -26,6 +30,7 @@ int main(int argc, const char* argv[]) {
 
 
 	std::string_view outputf;
+	std::string_view memory_budget;
 	std::vector<std::string_view> warnings;
 	std::vector<std::string_view> path_dirs;
 
@@ -35,6 +40,9 @@ int main(int argc, const char* argv[]) {
 	bool disable_colour = false;
 	bool inline_reports = false;
 	bool force = false;
+	bool tree = false;
+	bool memoize = false;
+	bool stats = false;
 
 	std::vector<const char*> positional;
 
@@ -49,7 +57,11 @@ int main(int argc, const char* argv[]) {
 		wpp::Opt{disable_colour, "toggle ANSI colour sequences",                      "--disable-colour", "-c"},
 		wpp::Opt{inline_reports, "toggle inline reports",                             "--inline-reports", "-i"},
 		wpp::Opt{force,          "overwrite file if it exists",                       "--force",          "-f"},
-		wpp::Opt{path_dirs,      "specify directories to search when sourcing files", "--search-path",    "-s"}
+		wpp::Opt{path_dirs,      "specify directories to search when sourcing files", "--search-path",    "-s"},
+		wpp::Opt{tree,           "evaluate using the tree walker instead of the vm",  "--tree",           "-T"},
+		wpp::Opt{memoize,        "cache the results of pure functions",               "--memoize",        "-m"},
+		wpp::Opt{stats,          "print evaluation statistics",                       "--stats",          "-S"},
+		wpp::Opt{memory_budget,  "memory available to the evaluator in MiB",          "--memory-budget",  "-M"}
 	))
 		return 0;
 
@@ -125,6 +137,27 @@ int main(int argc, const char* argv[]) {
 	if (inline_reports)
 		flags |= wpp::FLAG_INLINE_REPORTS;
 
+	if (memoize)
+		flags |= wpp::FLAG_MEMOIZE;
+
+
+	size_t budget = wpp::DEFAULT_MEMORY_BUDGET;
+
+	if (not memory_budget.empty()) {
+		constexpr size_t MiB = 1024 * 1024;
+
+		const auto [ptr, ec] = std::from_chars(memory_budget.data(), memory_budget.data() + memory_budget.size(), budget);
+
+		// A budget of 0 would fail the first call and anything larger than
+		// this overflows once converted to bytes.
+		if (ec != std::errc{} or ptr != memory_budget.data() + memory_budget.size() or budget == 0 or budget > SIZE_MAX / MiB) {
+			std::cerr << "error: invalid memory budget '" << memory_budget << "'\n";
+			return 1;
+		}
+
+		budget *= MiB;
+	}
+
 
 	// Build search path.
 	wpp::SearchPath search_path;
@@ -142,7 +175,7 @@ int main(int argc, const char* argv[]) {
 	}
 
 
-	std::string out;
+	wpp::Output out;
 	const auto initial_path = std::filesystem::current_path();
 
 	for (const auto& fname: positional) {
@@ -151,16 +184,28 @@ int main(int argc, const char* argv[]) {
 		std::filesystem::current_path(path.parent_path());
 
 		wpp::Env env{ initial_path, search_path, flags };
+		env.memory_budget = budget;
+		env.output = &out;
 
 		try {
-			env.sources.push(path, wpp::read_file(path), wpp::modes::normal);
+			env.sources.push(path, wpp::read_source(path), wpp::modes::normal);
 
 			wpp::node_t root = wpp::parse(env);
 
 			if (env.state & wpp::ABORT_EVALUATION)
 				return 1;
 
-			out += wpp::evaluate(root, env);
+			// The vm keeps its stacks on the heap so only the memory budget
+			// limits how deep a program can recurse, the tree walker is
+			// also limited by the native stack.
+			if (tree)
+				wpp::evaluate(root, env, nullptr, out.text);
+
+			else
+				wpp::execute(root, env, out.text);
+
+			if (stats)
+				wpp::report_stats(env);
 		}
 
 		catch (const wpp::Report& e) {
@@ -200,11 +245,16 @@ int main(int argc, const char* argv[]) {
 			return 1;
 		}
 
-		wpp::write_file(outputf, out);
+		if (not wpp::write_output(out, outputf)) {
+			std::cerr << "error: cannot write '" << outputf << "'\n";
+			return 1;
+		}
 	}
 
-	else
-		std::cout << out;
+	else if (not wpp::write_output(out)) {
+		std::cerr << "error: cannot write output\n";
+		return 1;
+	}
 
 	return 0;
 }
@@ -3,10 +3,23 @@
 #ifndef WOTPP_CONSTANTS
 #define WOTPP_CONSTANTS
 
+#include <cstddef>
+
 namespace wpp {
 	constexpr auto MAX_EXPR_DEPTH = 256;  // Depth at which to warn about deeply nested expressions/statements
 	constexpr auto MAX_REC_DEPTH  = 256;  // Depth at which to warn about deeply nested function calls
 	constexpr auto MAX_ERRORS     = 10;   // Max number of errors to print when doing error recovery
+
+	constexpr auto MAX_MEMO_ARGS_SIZE = 4096;  // Calls with more argument data than this are not memoized
+	constexpr auto MEMO_BUDGET_SHARE  = 4;     // Memoized results may use 1/n of the memory budget
+	constexpr auto MAX_CACHED_EVALS   = 64;    // Unreferenced trees parsed by `!` that are kept for reuse
+	constexpr auto BYTES_PER_NODE     = 6;     // Source text per node when reserving the tree, most sources have more
+
+	constexpr size_t DEFAULT_MEMORY_BUDGET = 256 * 1024 * 1024;  // Bytes the evaluator may use for its stacks
+	constexpr size_t FILE_CACHE_BUDGET     = 64 * 1024 * 1024;   // Bytes of file contents kept for `file`
+	constexpr size_t OUTPUT_SPAN_THRESHOLD = 64 * 1024;          // Top level values this large are not copied into the output
+	constexpr size_t FILE_PASSTHROUGH_SIZE = 1024 * 1024;        // Files this large are mapped by `file` and copied to the output by the kernel
+	constexpr size_t MAX_LEASED_FILES      = 64;                 // Mapped files held by `file` at once, any more are read
 }
 
 #endif
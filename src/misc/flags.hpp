@@ -33,6 +33,8 @@ namespace wpp {
 		ABORT_ERROR_RECOVERY    = 0b001000000000000000,
 		ABORT_EVALUATION        = 0b010000000000000000,
 
+		FLAG_MEMOIZE            = 0b100000000000000000,
+
 		FLAG_DEFAULT            = WARN_DEEP_EXPRESSION | WARN_DEEP_RECURSION,
 	};
 }
@@ -14,6 +14,7 @@ namespace wpp {
 
 	using flags_t = uint32_t;
 	using node_t = int32_t;
+	using symbol_t = uint32_t;
 
 	using token_type_t = uint8_t;
 
@@ -14,7 +14,7 @@
 
 	#include <misc/util/util.hpp>
 	#include <frontend/parser/parser.hpp>
-	#include <backend/eval/eval.hpp>
+	#include <backend/vm/vm.hpp>
 #endif
 
 
@@ -50,7 +50,8 @@ namespace wpp {
 					if (env.state & wpp::ERROR_MODE_PARSE)
 						return 1;
 
-					std::string out = wpp::evaluate(root, env);
+					std::string out;
+					wpp::execute(root, env, out);
 
 					if (not out.empty() and out.back() != '\n')
 						out += '\n';
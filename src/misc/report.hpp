@@ -3,6 +3,9 @@
 #ifndef WOTPP_LOGGING
 #define WOTPP_LOGGING
 
+#include <algorithm>
+#include <tuple>
+
 #include <structures/environment.hpp>
 #include <frontend/char.hpp>
 #include <frontend/view.hpp>
@@ -25,6 +28,9 @@ namespace wpp {
 			else if constexpr(std::is_same_v<std::decay_t<decltype(x)>, wpp::View>)
 				return x.str();
 
+			else if constexpr(std::is_same_v<std::decay_t<decltype(x)>, wpp::Str>)
+				return x.str();
+
 			else
 				return std::to_string(x);
 		};
@@ -38,22 +44,79 @@ namespace wpp {
 	}
 
 
+	inline void report_stats(const wpp::Env& env) {
+		const auto& stats = env.stats;
+
+		std::cerr << "memo: " << stats.memo_hits << " hit(s), " << stats.memo_misses << " miss(es), " << stats.memo_impure << " impure call(s), " << stats.memo_evicted << " evicted";
+
+		if (const size_t lookups = stats.memo_hits + stats.memo_misses; lookups != 0)
+			std::cerr << " (" << (stats.memo_hits * 100 / lookups) << "% hit rate)";
+
+		std::cerr << '\n';
+
+		std::cerr << "alloc: " << stats.arg_allocs << " argument stack allocation(s)\n";
+
+		std::cerr << "eval: " << stats.eval_hits << " cached, " << stats.eval_misses << " parsed, " << stats.eval_reclaimed << " reclaimed\n";
+
+		std::cerr << "lex: " << stats.tokens_lexed << " token(s), " << stats.tokens_relexed << " re-lexed\n";
+
+		std::cerr << "file: " << stats.file_hits << " hit(s), " << stats.file_misses << " miss(es), " << stats.file_evicted << " evicted\n";
+
+		// Everything the tree keeps per node: the fixed size nodes, their
+		// child lists, string payloads and source positions.
+		const auto& ast = env.ast;
+
+		const size_t node_bytes = ast.size() * sizeof(wpp::AST::value_type);
+		const size_t pool_bytes = ast.pool.size() * sizeof(uint32_t);
+		const size_t meta_bytes = env.ast_meta.size() * sizeof(wpp::Meta);
+
+		// Slices of a source share its text and only cost their `Str`.
+		size_t string_bytes = ast.strings.size() * sizeof(wpp::Str);
+		size_t sliced = 0;
+
+		for (const auto& str: ast.strings) {
+			if (str.is_slice())
+				sliced++;
+
+			else if (str.size() > wpp::Str::INLINE_CAPACITY)
+				string_bytes += str.size();
+		}
+
+		const size_t total = node_bytes + pool_bytes + string_bytes + meta_bytes;
+
+		std::cerr << "ast: " << ast.size() << " node(s), " << total << " bytes";
+
+		if (not ast.empty())
+			std::cerr << " (" << total / ast.size() << " bytes/node: "
+				<< sizeof(wpp::AST::value_type) << " node, "
+				<< pool_bytes / ast.size() << " children, "
+				<< string_bytes / ast.size() << " strings, "
+				<< meta_bytes / ast.size() << " positions)";
+
+		std::cerr << ", " << sliced << " of " << ast.strings.size() << " string(s) sliced from source\n";
+	}
+
+
 	struct SourceLocation {
 		int line = 1, column = 1;
 	};
 
 
-	// Calculate lines and columns encountered between `ptr` and `end`.
-	inline wpp::SourceLocation calculate_coordinates(const char* ptr, const char* const end) {
+	// Calculate the line and column of `end` in `source`. The line is found
+	// by a binary search of the line starts and only the codepoints of that
+	// line are walked to find the column.
+	inline wpp::SourceLocation calculate_coordinates(const wpp::Source& source, const char* const end) {
 		DBG();
 
-		int line = 1, column = 1;
+		const auto& lines = source.line_starts();
+		const auto offset = static_cast<uint32_t>(end - source.base);
 
-		for (; ptr < end; ptr = utf8::next(ptr)) {
-			const int cmp = (*ptr == '\n');
-			column = (column * not cmp) + 1;
-			line += cmp;
-		}
+		const auto it = std::upper_bound(lines.begin(), lines.end(), offset) - 1;
+
+		int line = static_cast<int>(it - lines.begin()) + 1, column = 1;
+
+		for (const char* ptr = source.base + *it; ptr < end; ptr = utf8::next(ptr))
+			++column;
 
 		return {line, column};
 	}
@@ -75,7 +138,7 @@ namespace wpp {
 
 		const auto& [source, view] = pos;
 		const auto& [offset, length] = view;
-		const auto& [file, base, mode] = *source;
+		const auto& [file, base, mode] = std::tie(source->file, source->base, source->mode);
 		const auto& [line, column] = sloc;
 
 		std::string str;
@@ -120,7 +183,7 @@ namespace wpp {
 
 		const auto& [source, view] = pos;
 		const auto& [offset, length] = view;
-		const auto& [file, base, mode] = *source;
+		const auto& [file, base, mode] = std::tie(source->file, source->base, source->mode);
 
 		std::string str;
 
@@ -148,7 +211,7 @@ namespace wpp {
 			++printout_end;
 
 		// Walk backwards to newline or beginning of string.
-		while (*(printout_begin - 1) != '\n' and printout_begin > base)
+		while (printout_begin > base and *(printout_begin - 1) != '\n')
 			--printout_begin;
 
 
@@ -211,9 +274,9 @@ namespace wpp {
 
 			const auto& [source, view] = pos;
 			const auto& [offset, length] = view;
-			const auto& [file, base, mode] = *source;
+			const auto& [file, base, mode] = std::tie(source->file, source->base, source->mode);
 
-			const auto sloc = wpp::calculate_coordinates(base, offset);
+			const auto sloc = wpp::calculate_coordinates(*source, offset);
 
 			const char* report_type_str = report_types::report_type_to_str[report_type];
 			const char* report_mode_str = report_modes::report_mode_to_str[report_mode];
@@ -281,7 +344,7 @@ namespace wpp {
 
 	template <typename... Ts>
 	inline wpp::Report generate_error(wpp::report_mode_type_t report_mode, wpp::node_t node_id, wpp::Env& env, Ts&&... args) {
-		return wpp::generate_error(report_mode, env.ast_meta[node_id].position, env, std::forward<Ts>(args)...);
+		return wpp::generate_error(report_mode, env.sources.position(env.ast_meta[node_id]), env, std::forward<Ts>(args)...);
 	}
 
 	template <typename... Ts>
@@ -305,7 +368,7 @@ namespace wpp {
 
 	template <typename... Ts>
 	inline wpp::Report generate_warning(wpp::report_mode_type_t report_mode, wpp::node_t node_id, wpp::Env& env, Ts&&... args) {
-		return wpp::generate_warning(report_mode, env.ast_meta[node_id].position, env, std::forward<Ts>(args)...);
+		return wpp::generate_warning(report_mode, env.sources.position(env.ast_meta[node_id]), env, std::forward<Ts>(args)...);
 	}
 
 	template <typename... Ts>
@@ -328,16 +391,18 @@ namespace wpp {
 
 	template <typename T>
 	inline bool is_previously_seen_warning(T warning_type, wpp::node_t node, wpp::Env& env) {
-		// std::cerr << warning_type << " " << node << " " << wpp::combine(warning_type, node) << " " <<
-		// 	(env.seen_warnings.find(wpp::combine(warning_type, node)) != env.seen_warnings.end()) << '\n';
+		const auto seen = [&] (wpp::node_t n) {
+			const auto it = env.seen_warnings.find(n);
+			return it != env.seen_warnings.end() and (it->second & warning_type);
+		};
 
 		const node_t first = node;
 
-		while (env.seen_warnings.find(wpp::combine(warning_type, node)) == env.seen_warnings.end()) {
+		while (not seen(node)) {
 			// std::cerr << node << ": found\n";
 			if (node == wpp::NODE_ROOT) {
 				// std::cerr << node << ": root\n";
-				env.seen_warnings.emplace(wpp::combine(warning_type, node));
+				env.seen_warnings[node] |= warning_type;
 				return false;
 			}
 
@@ -3,6 +3,16 @@
 #ifndef WOTPP_UTF8
 #define WOTPP_UTF8
 
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// The vectorised validator needs AVX2 which is picked at runtime.
+#if (defined(__GNUC__) or defined(__clang__)) and defined(__x86_64__)
+	#define WPP_UTF8_AVX2
+	#include <immintrin.h>
+#endif
+
 namespace wpp::utf8 {
 	// Get the size of a UTF-8 codepoint.
 	inline uint8_t codepoint_size(const char* const ptr) {
@@ -96,7 +106,229 @@ namespace wpp::utf8 {
 		}
 	}
 
+	namespace detail {
+		// Check 16 bytes at once for anything outside of ASCII.
+		inline bool is_ascii(const uint8_t* s) {
+			uint64_t a, b;
+			std::memcpy(&a, s, 8);
+			std::memcpy(&b, s + 8, 8);
+
+			return ((a | b) & 0x8080808080808080ull) == 0;
+		}
+
+
+		// Run the DFA over `n` bytes, skipping blocks of ASCII whenever we are
+		// between codepoints.
+		inline bool valid_scalar(const uint8_t* s, size_t n) {
+			const uint8_t* const end = s + n;
+
+			uint32_t codepoint = 0;
+			uint32_t state = UTF8_ACCEPT;
+
+			while (s != end) {
+				if (state == UTF8_ACCEPT) {
+					while (end - s >= 16 and is_ascii(s))
+						s += 16;
+
+					if (s == end)
+						break;
+				}
+
+				state = decode(state, codepoint, *s++);
+
+				if (state == UTF8_REJECT)
+					return false;
+			}
+
+			return state == UTF8_ACCEPT;
+		}
+	}
+
+
+	#if defined(WPP_UTF8_AVX2)
+		#if defined(__clang__)
+			#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+		#else
+			#pragma GCC push_options
+			#pragma GCC target("avx2")
+		#endif
+
+		// Validation with lookup tables, 32 bytes at a time.
+		// See "Validating UTF-8 In Less Than One Instruction Per Byte" by
+		// John Keiser and Daniel Lemire for how this works.
+		//
+		// Every invalid sequence is caught by looking at the high nibble of
+		// a byte and the high and low nibbles of the byte before it. Each
+		// table maps a nibble to the set of errors it may be part of and an
+		// error is only real if all three agree. Missing or surplus
+		// continuation bytes after 3 and 4 byte leads are checked
+		// separately.
+		namespace detail::avx2 {
+			constexpr uint8_t TOO_SHORT      = 1 << 0;   // Lead byte followed by a lead or ASCII byte.
+			constexpr uint8_t TOO_LONG       = 1 << 1;   // ASCII followed by a continuation.
+			constexpr uint8_t OVERLONG_3     = 1 << 2;
+			constexpr uint8_t TOO_LARGE      = 1 << 3;   // Above U+10FFFF.
+			constexpr uint8_t SURROGATE      = 1 << 4;
+			constexpr uint8_t OVERLONG_2     = 1 << 5;
+			constexpr uint8_t TOO_LARGE_1000 = 1 << 6;
+			constexpr uint8_t OVERLONG_4     = 1 << 6;
+			constexpr uint8_t TWO_CONTS      = 1 << 7;   // Two continuations in a row, checked below.
+			constexpr uint8_t CARRY          = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+			alignas(16) constexpr uint8_t byte_1_high[16] = {
+				// 0xxx: ASCII
+				TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+				TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+				// 10xx: continuation
+				TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+				// 1100, 1101: 2 byte lead
+				TOO_SHORT | OVERLONG_2,
+				TOO_SHORT,
+				// 1110: 3 byte lead
+				TOO_SHORT | OVERLONG_3 | SURROGATE,
+				// 1111: 4 byte lead
+				TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4,
+			};
+
+			alignas(16) constexpr uint8_t byte_1_low[16] = {
+				CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,   // 0000
+				CARRY | OVERLONG_2,                             // 0001
+				CARRY,                                          // 0010
+				CARRY,                                          // 0011
+				CARRY | TOO_LARGE,                              // 0100
+				CARRY | TOO_LARGE | TOO_LARGE_1000,             // 0101
+				CARRY | TOO_LARGE | TOO_LARGE_1000,
+				CARRY | TOO_LARGE | TOO_LARGE_1000,
+				CARRY | TOO_LARGE | TOO_LARGE_1000,
+				CARRY | TOO_LARGE | TOO_LARGE_1000,
+				CARRY | TOO_LARGE | TOO_LARGE_1000,
+				CARRY | TOO_LARGE | TOO_LARGE_1000,
+				CARRY | TOO_LARGE | TOO_LARGE_1000,
+				CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE, // 1101
+				CARRY | TOO_LARGE | TOO_LARGE_1000,
+				CARRY | TOO_LARGE | TOO_LARGE_1000,
+			};
+
+			alignas(16) constexpr uint8_t byte_2_high[16] = {
+				// 0xxx: ASCII
+				TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+				TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+				// 1000, 1001, 101x: continuation
+				TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+				TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+				TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE  | TOO_LARGE,
+				TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE  | TOO_LARGE,
+				// 11xx: lead
+				TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+			};
+
+			// The last 3 bytes of a block must not start a sequence that
+			// runs past the end of the input.
+			alignas(32) constexpr uint8_t incomplete[32] = {
+				255, 255, 255, 255, 255, 255, 255, 255,
+				255, 255, 255, 255, 255, 255, 255, 255,
+				255, 255, 255, 255, 255, 255, 255, 255,
+				255, 255, 255, 255, 255, 0xEF, 0xDF, 0xBF,
+			};
+
+
+			inline __m256i table(const uint8_t* t) {
+				return _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(t)));
+			}
+
+			// The input shifted back by `N` bytes, pulling in the end of the
+			// previous block.
+			template <int N>
+			inline __m256i prev(__m256i input, __m256i prev_input) {
+				return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev_input, input, 0x21), 16 - N);
+			}
+
+
+			inline bool valid(const uint8_t* s, size_t n) {
+				const __m256i low_nibble = _mm256_set1_epi8(0x0F);
+				const __m256i max_value = _mm256_load_si256(reinterpret_cast<const __m256i*>(incomplete));
+
+				const __m256i t1h = table(byte_1_high);
+				const __m256i t1l = table(byte_1_low);
+				const __m256i t2h = table(byte_2_high);
+
+				__m256i error = _mm256_setzero_si256();
+				__m256i prev_input = _mm256_setzero_si256();
+				__m256i prev_incomplete = _mm256_setzero_si256();
+
+				const auto step = [&] (__m256i input) {
+					if (_mm256_movemask_epi8(input) == 0)
+						error = _mm256_or_si256(error, prev_incomplete);
+
+					else {
+						const __m256i prev1 = prev<1>(input, prev_input);
+
+						const __m256i special = _mm256_and_si256(
+							_mm256_and_si256(
+								_mm256_shuffle_epi8(t1h, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), low_nibble)),
+								_mm256_shuffle_epi8(t1l, _mm256_and_si256(prev1, low_nibble))
+							),
+							_mm256_shuffle_epi8(t2h, _mm256_and_si256(_mm256_srli_epi16(input, 4), low_nibble))
+						);
+
+						// Bytes which must be the second or third continuation
+						// of a 3 or 4 byte sequence.
+						const __m256i third = _mm256_subs_epu8(prev<2>(input, prev_input), _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+						const __m256i fourth = _mm256_subs_epu8(prev<3>(input, prev_input), _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+						const __m256i must_continue = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(static_cast<char>(0x80)));
+
+						error = _mm256_or_si256(error, _mm256_xor_si256(must_continue, special));
+						prev_incomplete = _mm256_subs_epu8(input, max_value);
+					}
+
+					prev_input = input;
+				};
+
+				for (; n >= 32; s += 32, n -= 32)
+					step(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(s)));
+
+				// Pad the tail with zeroes which are ASCII.
+				if (n) {
+					alignas(32) uint8_t tail[32] = {};
+					std::memcpy(tail, s, n);
+					step(_mm256_load_si256(reinterpret_cast<const __m256i*>(tail)));
+				}
+
+				error = _mm256_or_si256(error, prev_incomplete);
+				return _mm256_testz_si256(error, error);
+			}
+		}
+
+		#if defined(__clang__)
+			#pragma clang attribute pop
+		#else
+			#pragma GCC pop_options
+		#endif
+	#endif
+
+
+	// Check that `n` bytes starting at `ptr` are valid UTF-8.
+	inline bool valid(const char* ptr, size_t n) {
+		const uint8_t* s = reinterpret_cast<const uint8_t*>(ptr);
+
+		#if defined(WPP_UTF8_AVX2)
+			static const bool has_avx2 = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+
+			if (has_avx2)
+				return detail::avx2::valid(s, n);
+		#endif
+
+		return detail::valid_scalar(s, n);
+	}
+
+
+	// Check a null terminated string. On failure `str` points to the
+	// offending byte.
 	inline bool validate(const char*& str) {
+		if (valid(str, std::strlen(str)))
+			return true;
+
+		// Walk the string again to find where it went wrong.
 		uint32_t codepoint = 0;
 		uint32_t state = 0;
 
@@ -1,5 +1,11 @@
 #include <string>
 #include <array>
+#include <iostream>
+#include <fstream>
+#include <optional>
+#include <list>
+#include <unordered_map>
+#include <algorithm>
 
 #include <cstdint>
 #include <cstdio>
@@ -9,6 +15,27 @@
 	#include <unistd.h>
 #endif
 
+#if defined(WPP_ENABLE_MMAP)
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+#if defined(WPP_ENABLE_FILE_CACHE)
+	#include <sys/stat.h>
+#endif
+
+#if defined(WPP_ENABLE_FILE_LEASE)
+	#include <sys/sendfile.h>
+	#include <csignal>
+	#include <cstring>
+	#include <cerrno>
+	#include <atomic>
+#endif
+
+#include <misc/util/util.hpp>
+
 namespace wpp {
 	// Execute a shell command, capture its standard output and return it
 	// https://stackoverflow.com/questions/478898/how-do-i-execute-a-command-and-get-the-output-of-the-command-within-c-using-po
@@ -98,5 +125,525 @@ namespace wpp {
 			return "";
 		}
 	#endif
-}
 
+
+	#if defined(WPP_ENABLE_MMAP)
+		namespace {
+			// Below this a plain read is cheaper than setting up a mapping.
+			constexpr off_t MMAP_THRESHOLD = 64 * 1024;
+
+			void unmap(const char* ptr, size_t extent, int) {
+				munmap(const_cast<char*>(ptr), extent);
+			}
+
+			// The lexer relies on a null terminator after the text. We
+			// reserve at least one byte more than the file and map the file
+			// over the start of it. The kernel zero-fills the remainder of
+			// the last page of the file and the reserved pages after it, so
+			// the terminator is there without copying anything.
+			const char* map_fd(int fd, size_t size, size_t& extent) {
+				const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+				extent = (size + page) / page * page;
+
+				void* const region = mmap(nullptr, extent, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+				if (region == MAP_FAILED)
+					return nullptr;
+
+				if (mmap(region, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+					munmap(region, extent);
+					return nullptr;
+				}
+
+				#if defined(MADV_SEQUENTIAL)
+					madvise(region, size, MADV_SEQUENTIAL);
+				#endif
+
+				return static_cast<const char*>(region);
+			}
+
+			// The mapping is private but truncating the file while we are
+			// running will still fault, the same as for any mapped file.
+			std::optional<wpp::Str> map_file(const std::filesystem::path& path) {
+				const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+				if (fd == -1)
+					throw wpp::FileReadError{};
+
+				struct stat st;
+
+				if (fstat(fd, &st) == -1 or not S_ISREG(st.st_mode) or st.st_size < MMAP_THRESHOLD) {
+					close(fd);
+					return std::nullopt;
+				}
+
+				const size_t size = static_cast<size_t>(st.st_size);
+				size_t extent{};
+
+				const char* const text = map_fd(fd, size, extent);
+				close(fd);
+
+				if (not text)
+					return std::nullopt;
+
+				return wpp::Str::external(text, size, extent, -1, unmap);
+			}
+		}
+	#endif
+
+
+	#if defined(WPP_ENABLE_FILE_LEASE)
+		namespace {
+			// Copy up to `n` bytes of `in` from `offset` to `out` without
+			// reading them ourselves. `copy_file_range` can share blocks
+			// between files on the same filesystem and `sendfile` copies to
+			// anything else. Returns how many bytes were copied, which is
+			// short if `in` ends early or neither call works.
+			size_t copy_range(int in, off_t offset, int out, size_t n) {
+				size_t left = n;
+				bool fallback = false;
+
+				while (left) {
+					const ssize_t copied = fallback ?
+						sendfile(out, in, &offset, left) :
+						copy_file_range(in, &offset, out, nullptr, left, 0);
+
+					if (copied == -1 and errno == EINTR)
+						continue;
+
+					if (copied == -1 and not fallback) {
+						fallback = true;
+						continue;
+					}
+
+					if (copied <= 0)
+						break;
+
+					left -= static_cast<size_t>(copied);
+				}
+
+				return n - left;
+			}
+
+
+			// Large files read by `file` are mapped instead of read and passed
+			// through to the output by the kernel, see `write_output`. We hold
+			// a read lease on each of them so that the kernel tells us before
+			// anyone opens one for writing or truncates it. They wait while we
+			// move a copy of the contents in place of the mapping, so a value
+			// never changes under us and only files which change are copied.
+			//
+			// The slots are shared with the signal handler. `fd` is set last
+			// and cleared first so the handler only sees complete slots.
+			struct LeasedFile {
+				volatile sig_atomic_t fd = -1;
+				volatile sig_atomic_t copied = false;
+				char* base = nullptr;
+				size_t size = 0;
+				size_t extent = 0;
+			};
+
+			LeasedFile leased_files[wpp::MAX_LEASED_FILES];
+
+
+			// Runs before someone writes to a leased file, only async-signal-safe
+			// calls from here on. The mapping still shows the old contents.
+			void break_lease(int, siginfo_t* info, void*) {
+				const int saved_errno = errno;
+
+				for (auto& file: leased_files) {
+					if (file.fd != info->si_fd or file.copied)
+						continue;
+
+					void* const copy = mmap(nullptr, file.extent, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+					if (copy == MAP_FAILED)
+						break;
+
+					std::memcpy(copy, file.base, file.size);
+
+					if (
+						mprotect(copy, file.extent, PROT_READ) == 0 and
+						mremap(copy, file.extent, file.extent, MREMAP_MAYMOVE | MREMAP_FIXED, file.base) != MAP_FAILED
+					)
+						file.copied = true;
+
+					else
+						munmap(copy, file.extent);
+
+					break;
+				}
+
+				fcntl(info->si_fd, F_SETLEASE, F_UNLCK);
+				errno = saved_errno;
+			}
+
+
+			void release_leased_file(const char* ptr, size_t extent, int fd) {
+				for (auto& file: leased_files) {
+					if (file.fd == fd) {
+						file.fd = -1;
+						std::atomic_signal_fence(std::memory_order_seq_cst);
+					}
+				}
+
+				fcntl(fd, F_SETLEASE, F_UNLCK);
+				munmap(const_cast<char*>(ptr), extent);
+				close(fd);
+			}
+
+
+			// Returns nothing if the file is small, we are out of slots or it
+			// can't be leased, it is read instead.
+			std::optional<wpp::Str> lease_file(const std::filesystem::path& path) {
+				static const bool installed = [] {
+					struct sigaction action{};
+					action.sa_sigaction = break_lease;
+					action.sa_flags = SA_SIGINFO | SA_RESTART;
+					sigemptyset(&action.sa_mask);
+
+					return sigaction(SIGIO, &action, nullptr) == 0;
+				}();
+
+				if (not installed)
+					return std::nullopt;
+
+				auto slot = std::find_if(std::begin(leased_files), std::end(leased_files), [] (const auto& file) {
+					return file.fd == -1;
+				});
+
+				if (slot == std::end(leased_files))
+					return std::nullopt;
+
+				const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+				if (fd == -1)
+					return std::nullopt;   // Left to `read_file` to report.
+
+				struct stat before;
+
+				if (fstat(fd, &before) == -1 or not S_ISREG(before.st_mode) or static_cast<size_t>(before.st_size) < wpp::FILE_PASSTHROUGH_SIZE) {
+					close(fd);
+					return std::nullopt;
+				}
+
+				const size_t size = static_cast<size_t>(before.st_size);
+				size_t extent{};
+
+				char* const text = const_cast<char*>(map_fd(fd, size, extent));
+
+				if (not text) {
+					close(fd);
+					return std::nullopt;
+				}
+
+				slot->copied = false;
+				slot->base = text;
+				slot->size = size;
+				slot->extent = extent;
+
+				std::atomic_signal_fence(std::memory_order_seq_cst);
+				slot->fd = fd;
+
+				// A lease can't be taken while the file is open for writing.
+				// Anything written before we had it shows up in `st_mtim`.
+				struct stat after;
+
+				const bool leased =
+					fcntl(fd, F_SETSIG, SIGIO) == 0 and
+					fcntl(fd, F_SETLEASE, F_RDLCK) == 0 and
+					fstat(fd, &after) == 0 and
+					after.st_size == before.st_size and
+					after.st_mtim.tv_sec == before.st_mtim.tv_sec and
+					after.st_mtim.tv_nsec == before.st_mtim.tv_nsec;
+
+				if (not leased) {
+					release_leased_file(text, extent, fd);
+					return std::nullopt;
+				}
+
+				return wpp::Str::external(text, size, extent, fd, release_leased_file);
+			}
+
+
+			bool is_copied(int fd) {
+				return std::any_of(std::begin(leased_files), std::end(leased_files), [fd] (const auto& file) {
+					return file.fd == fd and file.copied;
+				});
+			}
+		}
+	#endif
+
+
+	namespace {
+		// Contents of a file for the `file` intrinsic.
+		wpp::Str read_file_contents(const std::filesystem::path& path) {
+			#if defined(WPP_ENABLE_FILE_LEASE)
+				if (auto text = lease_file(wpp::resolve_file(path)))
+					return std::move(*text);
+			#endif
+
+			return wpp::Str{ wpp::read_file(path) };
+		}
+	}
+
+
+	wpp::Str read_source(const std::filesystem::path& path) {
+		#if defined(WPP_ENABLE_MMAP)
+			const auto file = wpp::resolve_file(path);
+
+			if (auto text = map_file(file))
+				return std::move(*text);
+
+			return wpp::Str::shared(wpp::read_file(file));
+
+		#else
+			return wpp::Str::shared(wpp::read_file(path));
+		#endif
+	}
+
+
+	#if defined(WPP_ENABLE_FILE_CACHE)
+		namespace {
+			// Files are identified by device and inode, which is what the
+			// canonical path resolves to, without having to walk the path.
+			struct FileKey {
+				dev_t dev;
+				ino_t ino;
+
+				bool operator==(const FileKey& other) const {
+					return dev == other.dev and ino == other.ino;
+				}
+			};
+
+			struct FileKeyHash {
+				size_t operator()(const FileKey& key) const {
+					return wpp::combine(key.dev, key.ino);
+				}
+			};
+
+			struct CachedFile {
+				FileKey key;
+
+				// The contents are reused only while these still match.
+				int64_t mtime;
+				off_t size;
+
+				wpp::Str text;
+				bool valid;   // Valid UTF-8, see `track_utf8`.
+			};
+
+
+			// Least recently used entries are at the back and are dropped
+			// first once the contents exceed `FILE_CACHE_BUDGET`. Dropped
+			// contents live on for as long as the evaluator refers to them.
+			struct FileCache {
+				std::list<CachedFile> entries{};
+				std::unordered_map<FileKey, std::list<CachedFile>::iterator, FileKeyHash> index{};
+				size_t bytes{};
+
+				void erase(std::list<CachedFile>::iterator it) {
+					bytes -= it->text.size();
+					index.erase(it->key);
+					entries.erase(it);
+				}
+			};
+
+
+			FileCache file_cache{};
+
+
+			int64_t mtime_of(const struct stat& st) {
+				#if defined(__APPLE__)
+					return static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1'000'000'000 + st.st_mtimespec.tv_nsec;
+				#else
+					return static_cast<int64_t>(st.st_mtim.tv_sec) * 1'000'000'000 + st.st_mtim.tv_nsec;
+				#endif
+			}
+		}
+	#endif
+
+
+	wpp::Str read_file_cached(const std::filesystem::path& path, wpp::Env& env) {
+		DBG();
+
+		#if defined(WPP_ENABLE_FILE_CACHE)
+			auto& cache = file_cache;
+
+			// Anything unusual is left to `read_file` to report.
+			struct stat st;
+			const bool cacheable = stat(path.c_str(), &st) == 0 and S_ISREG(st.st_mode);
+
+			// `st` is only filled in if the call succeeded.
+			const FileKey key = cacheable ? FileKey{ st.st_dev, st.st_ino } : FileKey{};
+
+			if (cacheable) {
+				if (auto found = cache.index.find(key); found != cache.index.end()) {
+					const auto it = found->second;
+
+					if (it->mtime == mtime_of(st) and it->size == st.st_size) {
+						env.stats.file_hits++;
+						cache.entries.splice(cache.entries.begin(), cache.entries, it);
+
+						if (not it->valid)
+							env.utf8_taint = true;
+
+						return it->text;
+					}
+
+					cache.erase(it);
+				}
+			}
+
+			env.stats.file_misses++;
+
+			// Leased files mostly end up passed straight through to the output
+			// so we don't read them only to check them.
+			wpp::Str text = wpp::read_file_contents(std::filesystem::relative(path));
+			const bool valid = text.fd() == -1 and utf8::valid(text.data(), text.size());
+
+			if (not valid)
+				env.utf8_taint = true;
+
+			if (not cacheable or text.size() > wpp::FILE_CACHE_BUDGET)
+				return text;
+
+			cache.entries.push_front({ key, mtime_of(st), st.st_size, text, valid });
+			cache.index.emplace(key, cache.entries.begin());
+			cache.bytes += text.size();
+
+			while (cache.bytes > wpp::FILE_CACHE_BUDGET) {
+				env.stats.file_evicted++;
+				cache.erase(std::prev(cache.entries.end()));
+			}
+
+			return text;
+
+		#else
+			env.stats.file_misses++;
+
+			wpp::Str text = wpp::read_file_contents(std::filesystem::relative(path));
+
+			if (text.fd() != -1)
+				env.utf8_taint = true;
+
+			else
+				wpp::track_utf8(text, env);
+
+			return text;
+		#endif
+	}
+
+
+	#if defined(WPP_ENABLE_FILE_LEASE)
+		namespace {
+			bool write_all(int fd, const char* ptr, size_t n) {
+				while (n) {
+					const ssize_t written = write(fd, ptr, n);
+
+					if (written == -1 and errno == EINTR)
+						continue;
+
+					if (written <= 0)
+						return false;
+
+					ptr += written;
+					n -= static_cast<size_t>(written);
+				}
+
+				return true;
+			}
+
+			// Leased files are copied to the output by the kernel so a large
+			// file passed through `file` is never read into memory. Writers
+			// wait for their lease to break until we are done, and files that
+			// have been copied already are written from memory.
+			bool write_leased(const wpp::Output& output, int fd) {
+				sigset_t io, old;
+				sigemptyset(&io);
+				sigaddset(&io, SIGIO);
+				sigprocmask(SIG_BLOCK, &io, &old);
+
+				size_t written = 0;
+				bool ok = true;
+
+				for (const auto& [offset, value]: output.spans) {
+					ok = write_all(fd, output.text.data() + written, offset - written);
+
+					if (not ok)
+						break;
+
+					written = offset;
+
+					size_t copied = 0;
+
+					if (value.fd() != -1 and not is_copied(value.fd()))
+						copied = copy_range(value.fd(), static_cast<off_t>(value.file_offset()), fd, value.size());
+
+					// Whatever the kernel didn't copy is written from the mapping.
+					ok = write_all(fd, value.data() + copied, value.size() - copied);
+
+					if (not ok)
+						break;
+				}
+
+				ok = ok and write_all(fd, output.text.data() + written, output.text.size() - written);
+
+				sigprocmask(SIG_SETMASK, &old, nullptr);
+				return ok;
+			}
+		}
+	#endif
+
+
+	bool write_output(const wpp::Output& output, const std::filesystem::path& path) {
+		DBG();
+
+		#if defined(WPP_ENABLE_FILE_LEASE)
+			const bool leased = std::any_of(output.spans.begin(), output.spans.end(), [] (const auto& span) {
+				return span.value.fd() != -1;
+			});
+
+			if (leased) {
+				if (path.empty())
+					return static_cast<bool>(std::cout.flush()) and write_leased(output, STDOUT_FILENO);
+
+				// Opening a leased file for writing breaks its lease, which
+				// needs the signal to be let through.
+				const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+
+				if (fd == -1)
+					return false;
+
+				const bool ok = write_leased(output, fd);
+				return close(fd) == 0 and ok;
+			}
+		#endif
+
+		std::ofstream file;
+
+		if (not path.empty())
+			file.open(path, std::ios::binary);
+
+		std::ostream& os = path.empty() ? std::cout : file;
+
+		const auto write = [&] (const char* ptr, size_t n) {
+			os.write(ptr, static_cast<std::streamsize>(n));
+		};
+
+		// Values are written from their own buffer in between the text
+		// around them.
+		size_t written = 0;
+
+		for (const auto& [offset, value]: output.spans) {
+			write(output.text.data() + written, offset - written);
+			write(value.data(), value.size());
+
+			written = offset;
+		}
+
+		write(output.text.data() + written, output.text.size() - written);
+
+		return static_cast<bool>(os.flush());
+	}
+}
@@ -101,8 +101,8 @@ namespace wpp {
 	}
 
 
-	// Read a file into a string relatively quickly.
-	inline std::string read_file(const std::filesystem::path& path) {
+	// Follow symlinks and make sure the result is a regular file.
+	inline std::filesystem::path resolve_file(const std::filesystem::path& path) {
 		DBG();
 		try {
 			auto cur = path;
@@ -122,24 +122,85 @@ namespace wpp {
 			if (not std::filesystem::exists(cur))
 				throw wpp::FileNotFoundError{};
 
+			return cur;
+		}
+
+		catch (const std::filesystem::filesystem_error&) {
+			throw wpp::FileReadError{};
+		}
+	}
+
 
-			std::ifstream is(cur, std::ios::binary);
+	// Read a file into a string relatively quickly.
+	inline std::string read_file(const std::filesystem::path& path) {
+		DBG();
 
-			if (not is.is_open())
-				throw wpp::FileReadError{};
+		const auto cur = wpp::resolve_file(path);
 
-			std::stringstream ss;
-			ss << is.rdbuf();
+		std::ifstream is(cur, std::ios::binary);
+
+		if (not is.is_open())
+			throw wpp::FileReadError{};
 
-			return ss.str();
+		// Read straight into the string rather than going through a stream
+		// buffer. Files that can't report their size are read in chunks.
+		std::string str;
+
+		is.seekg(0, std::ios::end);
+
+		if (const auto size = is.tellg(); size > 0) {
+			str.resize(static_cast<size_t>(size));
+			is.seekg(0);
+			is.read(str.data(), size);
+			str.resize(static_cast<size_t>(is.gcount()));
 		}
 
-		catch (const std::filesystem::filesystem_error&) {
-			throw wpp::FileReadError{};
+		else {
+			is.clear();
+			is.seekg(0);
+
+			char buffer[4096];
+
+			while (is.read(buffer, sizeof(buffer)) or is.gcount() > 0)
+				str.append(buffer, static_cast<size_t>(is.gcount()));
 		}
+
+		if (is.bad())
+			throw wpp::FileReadError{};
+
+		return str;
+	}
+
+
+	// Read a file for the `file` intrinsic. Contents are cached for the rest
+	// of the process and shared with the caller until the file changes.
+	wpp::Str read_file_cached(const std::filesystem::path&, wpp::Env&);
+
+
+	// Load a source file for the lexer. Large files are mapped read-only
+	// instead of being copied where the platform supports it.
+	wpp::Str read_source(const std::filesystem::path&);
+
+
+	// Append a value produced at the top level of the program to `out`.
+	// Large values are kept by reference and written to the output from
+	// their own buffer instead of being copied. Inside a call the caller
+	// may read back what was appended, see `call_func`, so only the top
+	// level does this.
+	inline void output(std::string& out, const wpp::Str& value, wpp::Env& env) {
+		if (value.size() >= wpp::OUTPUT_SPAN_THRESHOLD and env.output and &out == &env.output->text and env.call_depth == 0)
+			env.output->spans.push_back({ out.size(), value });
+
+		else
+			out += value;
 	}
 
 
+	// Write the output to `path`, or to standard output if it is empty.
+	// Returns false if it could not be written.
+	bool write_output(const wpp::Output&, const std::filesystem::path& = {});
+
+
 	// Write string to file.
 	inline void write_file(const std::filesystem::path& path, const std::string& contents) {
 		DBG();
@@ -147,6 +208,15 @@ namespace wpp {
 		file << contents;
 		file.close();
 	}
+
+
+	// Strings which don't come from a validated source may hold any bytes.
+	// As long as none of them are invalid UTF-8, every string the evaluator
+	// builds is valid too and `!` can skip validating its input.
+	inline void track_utf8(std::string_view str, wpp::Env& env) {
+		if (not env.utf8_taint and not utf8::valid(str.data(), str.size()))
+			env.utf8_taint = true;
+	}
 }
 
 
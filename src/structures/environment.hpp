@@ -5,34 +5,69 @@
 
 #include <filesystem>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <stack>
 #include <list>
+#include <deque>
 #include <map>
 #include <unordered_map>
 #include <unordered_set>
+#include <optional>
+#include <memory_resource>
 
 #include <cstdint>
+#include <cstring>
 
 #include <misc/flags.hpp>
 #include <misc/fwddecl.hpp>
+#include <misc/constants.hpp>
+#include <structures/str.hpp>
 #include <frontend/parser/ast_nodes.hpp>
 
 
 namespace wpp {
 	struct Source {
 		const std::filesystem::path file{};
-		const char* const base = nullptr;
+		const wpp::Str text{};   // Shared with the string literals that are sliced from it.
+		const char* const base = nullptr;   // Null terminated.
+		const size_t size{};
 		const wpp::mode_type_t mode{};
+		const uint32_t id{};   // Index in `Sources::table`.
+		const bool validated{};   // Known to be valid UTF-8, the lexer skips checking it.
+
+		mutable std::vector<uint32_t> lines{};   // Offset of the start of each line, see `line_starts`.
 
 		Source(
 			const std::filesystem::path& file_,
-			const char* const base_,
-			const wpp::mode_type_t mode_
+			wpp::Str&& text_,
+			const wpp::mode_type_t mode_,
+			const uint32_t id_,
+			const bool validated_ = false
 		):
 			file(file_),
-			base(base_),
-			mode(mode_) {}
+			text(std::move(text_)),
+			base(text.data()),
+			size(text.size()),
+			mode(mode_),
+			id(id_),
+			validated(validated_) {}
+
+		// Built on first use so that sources which never produce a report
+		// don't pay for it.
+		const std::vector<uint32_t>& line_starts() const {
+			if (not lines.empty())
+				return lines;
+
+			const char* const end = base + size;
+
+			lines.emplace_back(0);
+
+			for (const char* ptr = base; (ptr = static_cast<const char*>(std::memchr(ptr, '\n', end - ptr))); ++ptr)
+				lines.emplace_back(static_cast<uint32_t>(ptr + 1 - base));
+
+			return lines;
+		}
 	};
 
 
@@ -42,72 +77,304 @@ namespace wpp {
 	};
 
 
+	// Positions are stored relative to their source so that every node only
+	// costs 16 bytes. A full `Pos` is rebuilt when a report needs one, see
+	// `Sources::position`.
 	struct Meta {
-		const wpp::Pos position;
-		const wpp::node_t parent;
+		uint32_t source{};
+		uint32_t offset{};
+		uint32_t length{};
+		wpp::node_t parent{};
 
 		Meta(const wpp::Pos& position_, const wpp::node_t parent_):
-			position(position_), parent(parent_) {}
+			source(position_.source->id),
+			offset(static_cast<uint32_t>(position_.view.ptr - position_.source->base)),
+			length(position_.view.length),
+			parent(parent_) {}
+	};
+
+
+	using ASTMeta = std::pmr::vector<wpp::Meta>;
+
+
+	// Identifiers are interned by the parser so that functions, variables and
+	// parameters can be looked up by a dense integer id instead of by name.
+	// Names are copied because the source they come from may be reclaimed.
+	struct Symbols {
+		std::unordered_map<wpp::View, wpp::symbol_t> ids{};
+		std::vector<wpp::View> names{};
+		std::pmr::deque<std::pmr::string> storage{};
+
+
+		Symbols() {}
+
+		explicit Symbols(std::pmr::memory_resource* resource):
+			storage(resource) {}
+
+		wpp::symbol_t intern(const wpp::View& name) {
+			if (auto it = ids.find(name); it != ids.end())
+				return it->second;
+
+			const auto& str = storage.emplace_back(name.ptr, name.length);
+			const wpp::View owned{ str.data(), name.length };
+
+			const auto symbol = static_cast<wpp::symbol_t>(names.size());
+
+			ids.emplace(owned, symbol);
+			names.emplace_back(owned);
+
+			return symbol;
+		}
+
+		const wpp::View& name(const wpp::symbol_t symbol) const {
+			return names[symbol];
+		}
+
+		size_t size() const {
+			return names.size();
+		}
+	};
+
+
+	// Both of these are indexed by symbol and grow lazily as definitions are
+	// made. An empty entry means the name is undefined.
+	using Overloads = std::pmr::map<size_t, std::pmr::vector<wpp::node_t>, std::greater<size_t>>;
+
+	using Variables = std::pmr::vector<std::optional<wpp::Str>>;
+	using Functions = std::pmr::vector<wpp::Overloads>;
+
+
+
+	// Inline cache for a call site. It remembers which `Fn` node the call
+	// resolved to and is only valid while `epoch` matches `Env::epoch`.
+	struct CallCache {
+		uint64_t epoch{};
+		size_t n_args{};
+		wpp::node_t func = wpp::NODE_EMPTY;
 	};
 
+	using CallCaches = std::vector<wpp::CallCache>;   // Indexed by node.
+
+
+	// Memoized results of pure functions, keyed by the `Fn` node that was
+	// called and its arguments.
+	struct MemoKey {
+		wpp::node_t func = wpp::NODE_EMPTY;
+		std::vector<wpp::Str> args{};
+
+		bool operator==(const MemoKey& other) const {
+			return func == other.func and args == other.args;
+		}
+	};
+
+	struct MemoHash {
+		size_t operator()(const MemoKey& key) const {
+			size_t hash = std::hash<wpp::node_t>{}(key.func);
+
+			for (const auto& arg: key.args)
+				hash ^= std::hash<std::string_view>{}(arg) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+
+			return hash;
+		}
+	};
 
-	using Variables = std::unordered_map<wpp::View, std::string>;
-	using Functions = std::unordered_map<wpp::View, std::map<size_t, std::vector<wpp::node_t>, std::greater<size_t>>>;
+	using MemoTable = std::unordered_map<wpp::MemoKey, wpp::Str, wpp::MemoHash>;
 
-	using Arguments = std::vector<std::unordered_map<wpp::View, std::string>>;
-	using ASTMeta = std::vector<wpp::Meta>;
+
+	// Whether a function has side effects, computed on its first call.
+	namespace purities {
+		enum: uint8_t {
+			unknown,
+			pure,
+			impure,
+		};
+	}
+
+	using Purities = std::vector<uint8_t>;   // Indexed by node.
+
+
+	// Counters reported by `--stats`.
+	struct Stats {
+		size_t memo_hits{};
+		size_t memo_misses{};
+		size_t memo_impure{};   // Calls which could not be memoized.
+		size_t memo_evicted{};   // Results dropped to stay within the memory budget.
+
+		size_t arg_allocs{};   // Times the scratch stack or the argument frames had to grow.
+
+		size_t eval_hits{};
+		size_t eval_misses{};
+		size_t eval_reclaimed{};
+
+		size_t tokens_lexed{};
+		size_t tokens_relexed{};   // Lexed again at the same position because the lexer mode changed.
+
+		size_t file_hits{};
+		size_t file_misses{};
+		size_t file_evicted{};
+	};
 
 
 	using SearchPath = std::vector<std::filesystem::path>;
 
 
+	// The arguments of the function being evaluated. They are stored
+	// contiguously on `Env::arguments` starting at `base` in the same order
+	// as the parameters of `func`.
 	struct FnEnv {
-		wpp::Arguments arguments;
+		wpp::node_t func = wpp::NODE_EMPTY;
+		size_t base{};
 	};
 
 
 	struct Sources {
 		std::list<wpp::Source> sources{};
-		std::list<std::string> strings{};
+		std::vector<const wpp::Source*> table{};   // Indexed by `Source::id`, null once erased.
 		std::unordered_set<std::string> previously_seen{};
 
 		bool is_previously_seen(const std::filesystem::path& p) const {
 			return previously_seen.find(p.string()) != previously_seen.end();
 		}
 
-		wpp::Source& push(const std::filesystem::path& file, const std::string& str, const wpp::mode_type_t mode) {
+		// `text` must have a null terminator just past its end, see `Str::shared`
+		// and `wpp::read_source`.
+		wpp::Source& push(const std::filesystem::path& file, wpp::Str&& text, const wpp::mode_type_t mode, const bool validated = false) {
 			previously_seen.emplace(file.string());
-			const auto& ref = strings.emplace_back(str);
-			return sources.emplace_back(file, ref.c_str(), mode);
+			auto& src = sources.emplace_back(file, std::move(text), mode, static_cast<uint32_t>(table.size()), validated);
+
+			table.emplace_back(&src);
+			return src;
+		}
+
+		wpp::Source& push(const std::filesystem::path& file, std::string str, const wpp::mode_type_t mode, const bool validated = false) {
+			return push(file, wpp::Str::shared(std::move(str)), mode, validated);
 		}
 
 		void pop() {
+			table[sources.back().id] = nullptr;
+			trim();
+
 			sources.pop_back();
-			strings.pop_back();
+		}
+
+		// Remove a source. Its text lives on for as long as literals refer to it.
+		void erase(const wpp::Source* source) {
+			auto source_it = sources.end();
+
+			while (source_it != sources.begin()) {
+				--source_it;
+
+				if (&*source_it == source) {
+					table[source->id] = nullptr;
+					trim();
+
+					sources.erase(source_it);
+					return;
+				}
+			}
 		}
 
 		const wpp::Source& top() const {
 			return sources.back();
 		}
+
+		// Rebuild the position of a node.
+		wpp::Pos position(const wpp::Meta& meta) const {
+			const wpp::Source* source = table[meta.source];
+			return { source, wpp::View{ source->base + meta.offset, meta.length } };
+		}
+
+		// Ids of erased sources at the end can be handed out again.
+		void trim() {
+			while (not table.empty() and table.back() == nullptr)
+				table.pop_back();
+		}
+	};
+
+
+	// The nodes and source text created by parsing the code of a `!`.
+	// A region is referenced while its code is running and for every
+	// definition of one of its functions. Unreferenced regions at the end
+	// of the tree can be reclaimed, see `wpp::reclaim_regions`.
+	struct Region {
+		wpp::node_t begin = wpp::NODE_EMPTY;
+		wpp::node_t end = wpp::NODE_EMPTY;
+
+		// Where the region starts in `AST::pool` and `AST::strings`.
+		uint32_t pool_begin{};
+		uint32_t strings_begin{};
+
+		const wpp::Source* source = nullptr;
+		std::string_view key{};   // Entry in `Env::eval_cache`.
+
+		size_t refs{};
 	};
 
+	using Regions = std::vector<wpp::Region>;   // Ordered by `begin`.
+
 
 	struct ScopedEnv {
 		wpp::node_t root{};
 	};
 
 
+	// The text produced by the top level of a program. Large values are kept
+	// by reference instead of being copied in and are written from their own
+	// buffer, see `wpp::output` and `wpp::write_output`.
+	struct Output {
+		struct Span {
+			size_t offset{};   // Where in `text` the value goes.
+			wpp::Str value{};
+		};
+
+		std::string text{};
+		std::vector<Span> spans{};
+	};
+
+
 	struct Env {
-		wpp::AST ast{};
+		// Names of symbols are only ever added so they live in an arena.
+		// Everything which grows, including the tree, comes from a pool
+		// which takes back the buffer a vector leaves behind when it grows
+		// where an arena would keep it. Both are freed in one go with the
+		// `Env`.
+		std::pmr::monotonic_buffer_resource arena{};
+		std::pmr::unsynchronized_pool_resource tables{};
+
+		wpp::AST ast{ &tables };
+
+		wpp::Symbols symbols{ &arena };
+		wpp::Functions functions{ &tables };
+		wpp::Variables variables{ &tables };
+
+		wpp::CallCaches call_caches{};
+		uint64_t epoch{};   // Bumped whenever a function is defined or dropped.
 
-		wpp::Functions functions{};
-		wpp::Variables variables{};
+		wpp::MemoTable memo{};
+		wpp::Purities purities{};
+		uint64_t memo_epoch{};   // Value of `epoch` when `memo` was filled.
+		size_t memo_bytes{};   // Memory held by `memo`, counted against `memory_budget`.
+		bool memo_taint{};   // Set when an impure function is called, see `memo_begin`.
 
-		std::vector<std::vector<std::string>> stack{};
-		std::unordered_set<wpp::node_t> seen_warnings{};
+		// Trees parsed by `!`, keyed by their source. The keys point into
+		// `sources` which is never popped during evaluation.
+		std::unordered_map<std::string_view, wpp::node_t> eval_cache{};
 
-		wpp::ASTMeta ast_meta{};
+		wpp::Regions regions{};
+		size_t dead_regions{};   // Regions with no references which are kept for `eval_cache`.
+
+		wpp::Stats stats{};
+
+		std::pmr::vector<std::pmr::vector<wpp::Str>> stack{ &tables };
+		std::vector<wpp::Str> arguments{};   // Argument frames, see `FnEnv`.
+		std::vector<wpp::Str> scratch{};   // Arguments of calls being set up, see `setup_call`.
+		std::vector<wpp::node_t> fn_scopes{};   // Functions enclosing the node being parsed.
+		std::unordered_map<wpp::node_t, wpp::flags_t> seen_warnings{};   // Warnings already reported under a node.
+
+		wpp::ASTMeta ast_meta{ &tables };
 		wpp::Sources sources{};
+		wpp::Output* output = nullptr;   // Set when evaluating a whole program, null for the REPL.
+		bool utf8_taint{};   // Set once a string which may not be valid UTF-8 has been produced, see `track_utf8`.
 
 		const std::filesystem::path root{};
 		const wpp::SearchPath path{};
@@ -118,6 +385,9 @@ namespace wpp {
 		size_t call_depth{};
 		size_t rec_depth{};
 
+		size_t memory_budget = wpp::DEFAULT_MEMORY_BUDGET;   // Bytes the evaluator may use for its stacks and `memo`.
+		uintptr_t native_stack_base{};   // Address near the bottom of the native stack.
+
 		size_t report_count{};
 
 		// Dynamic dispatch. We change this function depending on whether or not colours
@@ -134,7 +404,9 @@ namespace wpp {
 			path(path_),
 			flags(flags_)
 		{
-			ast.reserve(ast.capacity() + (1024 * 1024 * 10) / sizeof(decltype(ast)::value_type)); // 10MiB tree.
+			char marker{};
+			native_stack_base = reinterpret_cast<uintptr_t>(&marker);
+
 			stack.emplace_back(); // Root stack.
 
 			if (flags & wpp::FLAG_DISABLE_COLOUR)
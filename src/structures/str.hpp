@@ -0,0 +1,278 @@
+#pragma once
+
+#ifndef WOTPP_STR
+#define WOTPP_STR
+
+#include <string>
+#include <algorithm>
+#include <string_view>
+#include <iostream>
+#include <utility>
+#include <cstring>
+#include <cstddef>
+
+
+namespace wpp {
+	// An immutable, reference counted string.
+	// Small strings are stored inline. Larger strings live in a heap allocated
+	// buffer which is shared by every copy so that passing a value around
+	// only costs a refcount increment. A `Str` may also refer to a slice of
+	// a shared buffer.
+	class Str {
+		public:
+			static constexpr size_t INLINE_CAPACITY = 16;
+
+
+		private:
+			struct Buffer {
+				size_t refs = 1;
+				const char* base = nullptr;
+				std::string data;
+
+				// Memory which we don't own, such as a mapped file. `release`
+				// is called with `extent` and `fd` to hand it back.
+				size_t extent = 0;
+				int fd = -1;   // File the memory is mapped from, if we keep it open.
+				void (*release)(const char*, size_t, int) = nullptr;
+
+				Buffer(std::string&& data_): data(std::move(data_)) {
+					base = data.data();
+				}
+
+				Buffer(const char* const base_, size_t extent_, int fd_, void (*release_)(const char*, size_t, int)):
+					base(base_), extent(extent_), fd(fd_), release(release_) {}
+
+				~Buffer() {
+					if (release)
+						release(base, extent, fd);
+				}
+
+				Buffer(const Buffer&) = delete;
+				Buffer& operator=(const Buffer&) = delete;
+			};
+
+
+			Buffer* buffer = nullptr;   // `nullptr` when stored inline.
+			size_t length = 0;
+
+			union {
+				size_t offset;   // Offset into `buffer`.
+				char local[INLINE_CAPACITY];
+			};
+
+
+			void acquire() {
+				if (buffer)
+					buffer->refs++;
+			}
+
+			void release() {
+				if (buffer and --buffer->refs == 0)
+					delete buffer;
+
+				buffer = nullptr;
+			}
+
+			void set_local(const char* const ptr, size_t n) {
+				length = n;
+				std::memcpy(local, ptr, n);
+			}
+
+
+		public:
+			Str(): offset(0) {}
+
+			explicit Str(std::string_view str): offset(0) {
+				if (str.size() <= INLINE_CAPACITY)
+					set_local(str.data(), str.size());
+
+				else {
+					buffer = new Buffer{std::string{str}};
+					length = str.size();
+				}
+			}
+
+			// Takes ownership of the string without copying it.
+			explicit Str(std::string&& str): offset(0) {
+				if (str.size() <= INLINE_CAPACITY)
+					set_local(str.data(), str.size());
+
+				else {
+					length = str.size();
+					buffer = new Buffer{std::move(str)};
+				}
+			}
+
+			explicit Str(const std::string& str): Str(std::string_view{str}) {}
+			explicit Str(const char* const str): Str(std::string_view{str}) {}
+
+
+			// Store the string in a heap buffer even if it is small so that
+			// `data()` is stable and null terminated. Used for source text
+			// which literals are sliced from.
+			static Str shared(std::string&& str) {
+				Str s;
+				s.length = str.size();
+				s.buffer = new Buffer{std::move(str)};
+				return s;
+			}
+
+			// Refer to `n` bytes of memory owned elsewhere without copying
+			// it. `release(ptr, extent, fd)` is called once the last copy is
+			// gone. `fd` is the file the memory is mapped from or -1.
+			static Str external(const char* const ptr, size_t n, size_t extent, int fd, void (*release)(const char*, size_t, int)) {
+				Str s;
+				s.length = n;
+				s.buffer = new Buffer{ptr, extent, fd, release};
+				return s;
+			}
+
+
+			Str(const Str& other): buffer(other.buffer), length(other.length) {
+				std::memcpy(local, other.local, INLINE_CAPACITY);
+				acquire();
+			}
+
+			Str(Str&& other) noexcept: buffer(other.buffer), length(other.length) {
+				std::memcpy(local, other.local, INLINE_CAPACITY);
+
+				other.buffer = nullptr;
+				other.length = 0;
+			}
+
+			Str& operator=(const Str& other) {
+				if (this != &other) {
+					release();
+
+					buffer = other.buffer;
+					length = other.length;
+					std::memcpy(local, other.local, INLINE_CAPACITY);
+
+					acquire();
+				}
+
+				return *this;
+			}
+
+			Str& operator=(Str&& other) noexcept {
+				if (this != &other) {
+					release();
+
+					buffer = other.buffer;
+					length = other.length;
+					std::memcpy(local, other.local, INLINE_CAPACITY);
+
+					other.buffer = nullptr;
+					other.length = 0;
+				}
+
+				return *this;
+			}
+
+			~Str() {
+				release();
+			}
+
+
+			const char* data() const {
+				return buffer ? buffer->base + offset : local;
+			}
+
+			size_t size() const {
+				return length;
+			}
+
+			bool empty() const {
+				return length == 0;
+			}
+
+			const char* begin() const { return data(); }
+			const char* end() const { return data() + length; }
+
+			// The file this string is mapped from or -1, and where in the file
+			// it starts. Lets the output copy it without reading it ourselves.
+			int fd() const {
+				return buffer ? buffer->fd : -1;
+			}
+
+			size_t file_offset() const {
+				return buffer ? offset : 0;
+			}
+
+			// Refers to part of a buffer it shares, such as a literal sliced
+			// from its source, rather than to a whole buffer of its own.
+			bool is_slice() const {
+				return buffer and length != buffer->data.size();
+			}
+
+			std::string_view view() const {
+				return { data(), length };
+			}
+
+			operator std::string_view() const {
+				return view();
+			}
+
+
+			// Copy the contents out into a mutable string.
+			std::string str() const & {
+				return std::string{ data(), length };
+			}
+
+			// Copy on write: if we are the only owner of the whole buffer we can
+			// hand it over instead of copying it.
+			std::string str() && {
+				if (buffer and not buffer->release and buffer->refs == 1 and offset == 0 and length == buffer->data.size()) {
+					std::string out = std::move(buffer->data);
+					release();
+					length = 0;
+					return out;
+				}
+
+				return str();
+			}
+
+
+			// A substring which shares the buffer of this string. The range is
+			// clamped to the string.
+			Str slice(size_t start, size_t n) const {
+				start = std::min(start, length);
+				n = std::min(n, length - start);
+
+				if (not buffer or n <= INLINE_CAPACITY)
+					return Str{ std::string_view{ data() + start, n } };
+
+				Str s;
+				s.buffer = buffer;
+				s.length = n;
+				s.offset = offset + start;
+				s.acquire();
+
+				return s;
+			}
+
+
+			friend bool operator==(const Str& lhs, const Str& rhs) {
+				return lhs.view() == rhs.view();
+			}
+
+			friend bool operator!=(const Str& lhs, const Str& rhs) {
+				return not(lhs == rhs);
+			}
+
+			friend bool operator==(const Str& lhs, std::string_view rhs) {
+				return lhs.view() == rhs;
+			}
+
+			friend bool operator!=(const Str& lhs, std::string_view rhs) {
+				return not(lhs == rhs);
+			}
+
+
+			friend std::ostream& operator<<(std::ostream& os, const Str& s) {
+				return os.write(s.data(), s.size());
+			}
+	};
+}
+
+#endif
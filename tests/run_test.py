@@ -10,13 +10,19 @@ import ast
 import re
 import os
 import subprocess
+import tempfile
 
 from operator import itemgetter
 
 
 # Run wot++ with test file.
+# Tests which run wot++ again find it in `WPP_EXE` and put their files in
+# `WPP_TMPDIR`, which is removed afterwards.
 def run(args):
-	res = subprocess.run(args, stdout=subprocess.PIPE, stderr=None)
+	with tempfile.TemporaryDirectory() as tmpdir:
+		env = dict(os.environ, WPP_EXE=os.path.abspath(args[0]), WPP_TMPDIR=tmpdir)
+		res = subprocess.run(args, stdout=subprocess.PIPE, stderr=None, env=env)
+
 	output = res.stdout.decode("UTF-8")
 
 	if res.returncode != 0:
@@ -26,12 +32,12 @@ def run(args):
 
 
 if __name__ == "__main__":
-	if len(sys.argv) != 3:
-		print("usage: <w++ exe> <test.wpp>")
+	if len(sys.argv) < 3:
+		print("usage: <w++ exe> <test.wpp> [w++ flags...]")
 		sys.exit(1)
 
 	# Unpack argv
-	_, binary, test_file = sys.argv
+	_, binary, test_file, *flags = sys.argv
 
 	# Ensure were running the w++ executable in the current directory
 	binary = f"./{binary}"
@@ -40,7 +46,7 @@ if __name__ == "__main__":
 	wpp_output = ""
 
 	try:
-		wpp_output = run([binary, test_file])
+		wpp_output = run([binary, *flags, test_file])
 
 	except RuntimeError as err:
 		print(f"w++ failed: {err.args[0]}")